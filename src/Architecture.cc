@@ -1,165 +1,631 @@
-#include "Architecture.h"
-#include "Module.h"
-#include <fstream>
-#include <iostream>
-#include <string>
-#include <string.h>
-
-using namespace std;
-
-#define DEBUG(x) cout<<x<<' ';
-
-Architecture::Architecture() {
-    num_sink_ = 0;
-    num_dispenser_ = 0;
-    num_mixer_ = 0;
-    num_detector_ = 0;
-}
-
-Architecture::Architecture(const string& filename){
-    build_from_file(filename);
-    print_to_graph(filename);
-}
-
-vector<string> split(string s, char c){
-    vector<string> res;
-    while(s.find(c) != string::npos){
-        string tmp = s.substr(0, s.find(c));
-        tmp = tmp.substr(tmp.find_first_not_of(' '), tmp.find_last_not_of(' ')-tmp.find_first_not_of(' ')+1);
-        res.push_back(tmp);
-        s = s.substr(s.find(c)+1);
-    }
-    string tmp = s;
-    tmp = tmp.substr(tmp.find_first_not_of(' '), tmp.find_last_not_of(' ')-tmp.find_first_not_of(' ')+1);
-    res.push_back(tmp);
-    return res;
-}
-
-void Architecture::build_from_file(const string &filename){
-    // erase previous data
-    num_sink_ = num_dispenser_ = 0;
-    for(auto edges: forward_edges_){
-        edges_.clear();
-    }
-    forward_edges_.clear();
-    for(auto edges: backward_edges_){
-        edges.clear();
-    }
-    backward_edges_.clear();
-    modules_.clear();
-
-    ifstream in_file(filename);
-    // process line by line
-    while(!in_file.eof()){
-        string line;
-        getline(in_file, line);
-        if(line.find('(') == string::npos){
-            continue;
-        }
-
-        string type = line.substr(0, line.find(' '));
-        auto params = split(line.substr(line.find('(')+1, line.find(')') - line.find('(')-1), ','); // TODO: test this
-        if(params.size() < 1){
-            cout << "Error reading input file: " << filename << endl;
-        }
-
-        if(type == "DAGNAME"){
-            label_ = params[0];
-        }else if(type == "EDGE"){
-            int u = stoi(params[0]);
-            int v = stoi(params[1]);
-            edges_.push_back(make_pair(u-1, v-1));
-        }else if(type == "NODE"){
-            Module m;
-            m.id_ = stoi(params[0]) - 1;
-            string type_module = params[1];
-            if(type_module == "MIX"){
-                m.type_ = MIXER;
-                m.drops_ = stoi(params[2]);
-                m.time_ = stoi(params[3]);
-                m.label_ = params[4];
-                num_mixer_++;
-            }else if(type_module == "DISPENSE"){
-                m.type_ = DISPENSER;
-                m.fluid_type_ = params[2];
-                m.volume_ = stoi(params[3]);
-                m.label_ = params[4];
-                num_dispenser_++;
-            }else if(type_module == "OUTPUT"){
-                m.type_ = SINK;
-                m.sink_name_ = params[2];
-                m.label_ = params[3];
-                num_sink_++;
-            }else if(type_module == "DETECT"){
-                m.type_ = DETECTOR;
-                m.drops_ = stoi(params[2]);
-                m.time_ = stoi(params[3]);
-                m.label_ = params[4];
-                num_detector_++;
-            }else{
-                cout << "Module type not yet supported!" << endl;
-            }
-            nodes_.push_back(m);
-            if(modules_.count(m.label_) == 0){
-                modules_[m.label_] = m;
-            }
-        }else if(type == "TIME"){
-            time_limit_ = stoi(params[0]);
-        }else if(type == "SIZE"){
-            width_limit_ = stoi(params[0]);
-            height_limit_ = stoi(params[1]);
-        }else if(type == "MOD"){
-            string label = params[0];
-            switch(modules_[label].type_){
-                case NONE:
-                    break;
-                case SINK:
-                case DISPENSER:
-                    modules_[label].desired_amount_ = stoi(params[1]);
-                    break;
-                case MIXER:
-                    modules_[label].w = stoi(params[1]);
-                    modules_[label].h = stoi(params[2]);
-                    break;
-                case DETECTOR:
-                    break;
-            }
-        }
-    }
-    in_file.close();
-
-    // prepare edge lists
-    forward_edges_.assign(nodes_.size(), vector<int>());
-    backward_edges_.assign(nodes_.size(), vector<int>());
-    for(auto edge: edges_){
-        forward_edges_[edge.first].push_back(edge.second);
-        backward_edges_[edge.second].push_back(edge.first);
-    }
-}
-
-void Architecture::print_to_graph(string filename){
-    filename = filename.substr(0, filename.find_last_of('.'));
-
-    ofstream out_file(filename+".dot");
-    out_file << "graph \"" << label_ << "\" {\n";
-    for(auto m: nodes_){
-        out_file << m.id_ << " [label=\"" << m.label_ << "\"";
-        if(m.type_ == DISPENSER){
-            out_file << ", shape=box, color=green";
-        }else if(m.type_ == MIXER){
-            out_file << ", shape=polygon, sides=4, skew=.5, color=yellow";
-        }else if(m.type_ == SINK){
-            out_file << ", shape=triangle, color=lightblue";
-        }
-        out_file << "]\n";
-    }
-    for(auto e: edges_){
-        out_file << e.first << " -- " << e.second << endl;
-    }
-    out_file << "}" << endl;
-    out_file.close();
-
-    char cmd[200];
-    sprintf(cmd, "dot -Tpng -o %s %s", (filename+".png").c_str(), (filename+".dot").c_str());
-    system(cmd);
-}
\ No newline at end of file
+#include "Architecture.h"
+#include "Module.h"
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <string.h>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+
+#define DEBUG(x) cout<<x<<' ';
+
+Architecture::Architecture() {
+    num_sink_ = 0;
+    num_dispenser_ = 0;
+    num_mixer_ = 0;
+    num_detector_ = 0;
+    width_limit_ = height_limit_ = time_limit_ = 0;
+}
+
+Architecture::Architecture(const string& filename){
+    build_from_file(filename);
+}
+
+namespace {
+
+// a run of characters in the file buffer, with where it starts
+struct Token {
+    const char* begin_;
+    int len_;
+    int line_;
+    int col_;
+
+    bool is(const char* s) const { return strncmp(begin_, s, len_) == 0 && s[len_] == '\0'; }
+    string str() const { return string(begin_, len_); }
+};
+
+// single pass over the file, one STATEMENT (param, param, ...) per line, // starts a comment
+struct Scanner {
+    const char* p_;
+    const char* end_;
+    int line_;
+    const char* line_start_;
+
+    Scanner(const char* begin, const char* end): p_(begin), end_(end), line_(1), line_start_(begin) {}
+
+    Token at() const { return Token{p_, 0, line_, (int)(p_ - line_start_) + 1}; }
+    bool comment() const { return p_ + 1 < end_ && p_[0] == '/' && p_[1] == '/'; }
+
+    void skip_spaces(){
+        while(p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r')){
+            p_++;
+        }
+    }
+    void skip_line(){
+        while(p_ < end_ && *p_ != '\n'){
+            p_++;
+        }
+    }
+    // spaces, empty lines and comments up to the next statement
+    void skip_blank(){
+        while(p_ < end_){
+            skip_spaces();
+            if(comment()){
+                skip_line();
+            }
+            if(p_ < end_ && *p_ == '\n'){
+                p_++;
+                line_++;
+                line_start_ = p_;
+            }else{
+                break;
+            }
+        }
+    }
+
+    // false at the end of the file, otherwise the statement or an error with where it is
+    bool next(Token& keyword, vector<Token>& params, string& error, Token& where){
+        error.clear();
+        params.clear();
+        skip_blank();
+        if(p_ >= end_){
+            return false;
+        }
+
+        keyword = at();
+        while(p_ < end_ && (isalnum(*p_) || *p_ == '_')){
+            p_++;
+        }
+        keyword.len_ = p_ - keyword.begin_;
+        skip_spaces();
+        where = at();
+        if(keyword.len_ == 0){
+            error = "expected a statement";
+            return true;
+        }
+        if(p_ >= end_ || *p_ != '('){
+            error = "expected '(' after " + keyword.str();
+            return true;
+        }
+        p_++;
+
+        while(true){
+            skip_spaces();
+            Token param = at();
+            while(p_ < end_ && *p_ != ',' && *p_ != ')' && *p_ != '(' && *p_ != '\n'){
+                p_++;
+            }
+            const char* last = p_;
+            while(last > param.begin_ && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r')){
+                last--;
+            }
+            param.len_ = last - param.begin_;
+            if(p_ >= end_ || *p_ == '\n' || *p_ == '('){
+                where = at();
+                error = p_ < end_ && *p_ == '(' ? "unexpected '('" : "missing ')'";
+                return true;
+            }
+            if(param.len_ == 0){
+                where = param;
+                error = "empty parameter";
+                return true;
+            }
+            params.push_back(param);
+            if(*p_++ == ')'){
+                break;
+            }
+        }
+
+        skip_spaces();
+        if(p_ < end_ && *p_ != '\n' && !comment()){
+            where = at();
+            error = "unexpected text after ')'";
+        }
+        return true;
+    }
+};
+
+bool parse_int(const Token& t, int& value){
+    int i = 0;
+    bool negative = t.len_ > 0 && t.begin_[0] == '-';
+    if(negative){
+        i++;
+    }
+    if(i == t.len_ || t.len_ - i > 9){
+        return false;
+    }
+    value = 0;
+    for(; i < t.len_; i++){
+        if(!isdigit(t.begin_[i])){
+            return false;
+        }
+        value = value * 10 + (t.begin_[i] - '0');
+    }
+    if(negative){
+        value = -value;
+    }
+    return true;
+}
+
+}
+
+void Architecture::add_error(const string& filename, int line, int col, const string& msg){
+    char pos[40];
+    if(line > 0){
+        sprintf(pos, ":%d:%d", line, col);
+    }else{
+        pos[0] = '\0';
+    }
+    errors_.push_back(filename + pos + ": " + msg);
+    cerr << errors_.back() << endl;
+}
+
+bool Architecture::build_from_file(const string &filename){
+    // the whole file in one buffer, every token points into it
+    ifstream in_file(filename, ios::binary);
+    if(!in_file.is_open()){
+        build_from_text(filename, ""); // nothing left of a previous file
+        add_error(filename, 0, 0, "cannot open file");
+        return false;
+    }
+    in_file.seekg(0, ios::end);
+    string buffer(in_file.tellg(), '\0');
+    in_file.seekg(0, ios::beg);
+    in_file.read(&buffer[0], buffer.size());
+    in_file.close();
+    return build_from_text(filename, buffer);
+}
+
+bool Architecture::build_from_text(const string& filename, const string& buffer){
+    // erase previous data
+    label_.clear();
+    edges_.clear();
+    forward_edges_.clear();
+    backward_edges_.clear();
+    modules_.clear();
+    nodes_.clear();
+    errors_.clear();
+    num_sink_ = num_dispenser_ = num_mixer_ = num_detector_ = 0;
+    width_limit_ = height_limit_ = time_limit_ = 0;
+
+    Scanner scanner(buffer.data(), buffer.data() + buffer.size());
+    Token keyword, where;
+    vector<Token> params;
+    string error;
+    vector<Token> node_tokens; // id token of every node, by id
+    vector<pair<Token, Token>> edge_tokens;
+
+    while(scanner.next(keyword, params, error, where)){
+        // checks a statement, the first failure is reported at the token it is about
+        auto fail = [&](const Token& t, const string& msg){
+            if(error.empty()){
+                error = msg;
+                where = t;
+            }
+        };
+        auto expect = [&](size_t n){
+            if(params.size() != n){
+                fail(keyword, keyword.str() + " takes " + to_string(n) + " parameters, got " + to_string(params.size()));
+                return false;
+            }
+            return true;
+        };
+        auto number = [&](size_t i){
+            int v = 0;
+            if(!parse_int(params[i], v)){
+                fail(params[i], "expected a number, got '" + params[i].str() + "'");
+            }
+            return v;
+        };
+
+        if(!error.empty()){
+            // already broken
+        }else if(keyword.is("DAGNAME")){
+            if(expect(1)){
+                label_ = params[0].str();
+            }
+        }else if(keyword.is("EDGE")){
+            // some files number the edges in a third parameter, which is not used
+            if(params.size() == 3 || expect(2)){
+                int u = number(0);
+                int v = number(1);
+                edges_.push_back(make_pair(u-1, v-1));
+                edge_tokens.push_back(make_pair(params[0], params[1]));
+            }
+        }else if(keyword.is("NODE")){
+            Module m = Module();
+            if(params.size() < 2){
+                expect(4);
+            }else{
+                m.id_ = number(0) - 1;
+                const Token& type_module = params[1];
+                if(type_module.is("MIX") && expect(5)){
+                    m.type_ = MIXER;
+                    m.drops_ = number(2);
+                    m.time_ = number(3);
+                    m.label_ = params[4].str();
+                    num_mixer_++;
+                }else if(type_module.is("DISPENSE") && expect(5)){
+                    m.type_ = DISPENSER;
+                    m.fluid_type_ = params[2].str();
+                    m.volume_ = number(3);
+                    m.label_ = params[4].str();
+                    m.desired_amount_ = 1;
+                    num_dispenser_++;
+                }else if(type_module.is("OUTPUT") && expect(4)){
+                    m.type_ = SINK;
+                    m.sink_name_ = params[2].str();
+                    m.label_ = params[3].str();
+                    m.desired_amount_ = 1;
+                    num_sink_++;
+                }else if(type_module.is("DETECT") && expect(5)){
+                    m.type_ = DETECTOR;
+                    m.drops_ = number(2);
+                    m.time_ = number(3);
+                    m.label_ = params[4].str();
+                    num_detector_++;
+                }else{
+                    fail(type_module, "module type '" + type_module.str() + "' not yet supported");
+                }
+            }
+            if(error.empty() && m.id_ < 0){
+                fail(params[0], "node ids start at 1");
+            }
+            if(error.empty()){
+                // nodes_ is indexed by id, whatever order they come in
+                if(m.id_ >= (int)nodes_.size()){
+                    nodes_.resize(m.id_ + 1, Module());
+                    node_tokens.resize(m.id_ + 1, Token{nullptr, 0, 0, 0});
+                }
+                if(node_tokens[m.id_].begin_ != nullptr){
+                    fail(params[0], "node " + params[0].str() + " is defined twice");
+                }else{
+                    nodes_[m.id_] = m;
+                    node_tokens[m.id_] = params[0];
+                    if(modules_.count(m.label_) == 0){
+                        modules_[m.label_] = m;
+                    }
+                }
+            }
+        }else if(keyword.is("TIME")){
+            if(expect(1)){
+                time_limit_ = number(0);
+            }
+        }else if(keyword.is("SIZE")){
+            if(expect(2)){
+                width_limit_ = number(0);
+                height_limit_ = number(1);
+            }
+        }else if(keyword.is("MOD")){
+            auto it = params.empty() ? modules_.end() : modules_.find(params[0].str());
+            if(params.empty()){
+                expect(2);
+            }else if(it == modules_.end()){
+                fail(params[0], "unknown module '" + params[0].str() + "'");
+            }else{
+                Module& module = it->second;
+                switch(module.type_){
+                    case SINK:
+                    case DISPENSER:
+                        if(expect(2)){
+                            module.desired_amount_ = number(1);
+                        }
+                        break;
+                    case MIXER:
+                        if(expect(3)){
+                            module.w = number(1);
+                            module.h = number(2);
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }else{
+            fail(keyword, "unknown statement '" + keyword.str() + "'");
+        }
+
+        if(!error.empty()){
+            add_error(filename, where.line_, where.col_, error);
+            scanner.skip_line();
+        }
+    }
+
+    // what can only be checked once everything is read
+    int no_of_nodes = nodes_.size();
+    for(int i = 0; i < no_of_nodes; i++){
+        if(node_tokens[i].begin_ == nullptr){
+            add_error(filename, 0, 0, "node " + to_string(i+1) + " is not defined");
+        }
+    }
+    for(size_t i = 0; i < edges_.size(); i++){
+        if(edges_[i].first < 0 || edges_[i].first >= no_of_nodes){
+            add_error(filename, edge_tokens[i].first.line_, edge_tokens[i].first.col_, "edge from undefined node " + edge_tokens[i].first.str());
+        }
+        if(edges_[i].second < 0 || edges_[i].second >= no_of_nodes){
+            add_error(filename, edge_tokens[i].second.line_, edge_tokens[i].second.col_, "edge to undefined node " + edge_tokens[i].second.str());
+        }
+    }
+    for(auto& pair: modules_){
+        const Module& m = pair.second;
+        if(m.type_ == MIXER && (m.w <= 0 || m.h <= 0)){
+            const Token& t = node_tokens[m.id_];
+            add_error(filename, t.line_, t.col_, "mixer " + m.label_ + " needs a size, MOD (" + m.label_ + ", width, height)");
+        }
+    }
+    if(!errors_.empty()){
+        return false;
+    }
+
+    // prepare edge lists
+    forward_edges_.assign(nodes_.size(), vector<int>());
+    backward_edges_.assign(nodes_.size(), vector<int>());
+    for(auto edge: edges_){
+        forward_edges_[edge.first].push_back(edge.second);
+        backward_edges_[edge.second].push_back(edge.first);
+    }
+
+    // the time windows follow the edges, so they have to be acyclic
+    vector<int> in_degree(no_of_nodes, 0);
+    for(auto edge: edges_){
+        in_degree[edge.second]++;
+    }
+    vector<int> ready;
+    for(int i = 0; i < no_of_nodes; i++){
+        if(in_degree[i] == 0){
+            ready.push_back(i);
+        }
+    }
+    int visited = 0;
+    while(!ready.empty()){
+        int n = ready.back();
+        ready.pop_back();
+        visited++;
+        for(int s: forward_edges_[n]){
+            if(--in_degree[s] == 0){
+                ready.push_back(s);
+            }
+        }
+    }
+    if(visited < no_of_nodes){
+        add_error(filename, 0, 0, "the edges form a cycle");
+        return false;
+    }
+
+    compute_time_windows();
+    return true;
+}
+
+future<int> Architecture::print_to_graph(string filename, bool render){
+    filename = filename.substr(0, filename.find_last_of('.'));
+
+    ofstream out_file(filename+".dot");
+    out_file << "graph \"" << label_ << "\" {\n";
+    for(auto m: nodes_){
+        out_file << m.id_ << " [label=\"" << m.label_ << "\"";
+        if(m.type_ == DISPENSER){
+            out_file << ", shape=box, color=green";
+        }else if(m.type_ == MIXER){
+            out_file << ", shape=polygon, sides=4, skew=.5, color=yellow";
+        }else if(m.type_ == SINK){
+            out_file << ", shape=triangle, color=lightblue";
+        }
+        out_file << "]\n";
+    }
+    for(auto e: edges_){
+        out_file << e.first << " -- " << e.second << endl;
+    }
+    out_file << "}" << endl;
+    out_file.close();
+
+    if(!render){
+        promise<int> done;
+        done.set_value(0);
+        return done.get_future();
+    }
+    // not a std::async future, which would wait for dot when the caller drops it
+    string cmd = "dot -Tpng -o \"" + filename + ".png\" \"" + filename + ".dot\"";
+    packaged_task<int()> task([cmd]{ return system(cmd.c_str()); });
+    future<int> done = task.get_future();
+    thread(move(task)).detach();
+    return done;
+}
+
+// earliest time step at which the output droplets of node n can appear
+int earliest_output(Architecture& arch, int n, vector<int>& memo){
+    if(memo[n] >= 0){
+        return memo[n];
+    }
+    int t = 1; // dispensed droplets appear at t = 1
+    const Module& m = arch.nodes_[n];
+    if(m.type_ == MIXER || m.type_ == DETECTOR){
+        // inputs are present at t-d-1 and the outputs appear at t
+        int ready = 1;
+        for(int p: arch.backward_edges_[n]){
+            ready = max(ready, earliest_output(arch, p, memo));
+        }
+        t = ready + m.time_ + 1;
+    }
+    memo[n] = t;
+    return t;
+}
+
+// time steps needed before the horizon by the input droplets of node n
+int input_slack(Architecture& arch, int n, vector<int>& memo){
+    if(memo[n] >= 0){
+        return memo[n];
+    }
+    int slack = 0;
+    const Module& m = arch.nodes_[n];
+    if(m.type_ == SINK){
+        slack = 1; // droplets to a sink have to be gone at the last step
+    }else if((m.type_ == MIXER || m.type_ == DETECTOR) && !arch.forward_edges_[n].empty()){
+        // all outputs appear together d+1 steps after the inputs were last present
+        for(int s: arch.forward_edges_[n]){
+            slack = max(slack, input_slack(arch, s, memo));
+        }
+        slack += m.time_ + 1;
+    }
+    memo[n] = slack;
+    return slack;
+}
+
+void Architecture::compute_time_windows(){
+    vector<int> memo_earliest(nodes_.size(), -1);
+    vector<int> memo_slack(nodes_.size(), -1);
+    earliest_.clear();
+    slack_.clear();
+    deadline_.clear();
+    for(auto edge: edges_){
+        earliest_.push_back(earliest_output(*this, edge.first, memo_earliest));
+        slack_.push_back(input_slack(*this, edge.second, memo_slack));
+    }
+}
+
+int Architecture::schedule(int width, int height, int route, int spare){
+    compute_time_windows();
+    int no_of_nodes = nodes_.size();
+    vector<int> memo_slack(no_of_nodes, -1);
+    vector<int> priority(no_of_nodes);
+    for(int n = 0; n < no_of_nodes; n++){
+        priority[n] = input_slack(*this, n, memo_slack);
+    }
+
+    // mixers with a cell of room around them share the grid, a detector takes one droplet at a time
+    vector<int> area_used;        // [t]
+    map<string, vector<bool>> busy; // detector label -> [t]
+    int area = (width + 1) * (height + 1);
+    auto fits = [&](int n, int s){
+        const Module& m = nodes_[n];
+        int footprint = m.type_ == MIXER ? (modules_[m.label_].w + 1) * (modules_[m.label_].h + 1) : 0;
+        vector<bool>& detector = busy[m.label_];
+        for(int t = s; t < s + m.time_; t++){
+            if(m.type_ == MIXER && t < (int)area_used.size() && area_used[t] + footprint > area){
+                return false;
+            }
+            if(m.type_ == DETECTOR && t < (int)detector.size() && detector[t]){
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // start: first step of the operation, finish: its outputs appear (inputs last present at start - 1)
+    vector<int> start(no_of_nodes, -1), finish(no_of_nodes, -1);
+    vector<int> waiting(no_of_nodes, 0);
+    for(int n = 0; n < no_of_nodes; n++){
+        for(int p: backward_edges_[n]){
+            waiting[n] += nodes_[p].type_ == MIXER || nodes_[p].type_ == DETECTOR;
+        }
+    }
+    while(true){
+        // the ready operation with the longest way to go
+        int best = -1;
+        for(int n = 0; n < no_of_nodes; n++){
+            if((nodes_[n].type_ == MIXER || nodes_[n].type_ == DETECTOR) && start[n] < 0 && waiting[n] == 0
+                    && (best < 0 || priority[n] > priority[best])){
+                best = n;
+            }
+        }
+        if(best < 0){
+            break;
+        }
+        const Module& m = nodes_[best];
+        int ready = 1 + route; // dispensed droplets walk in from the border
+        for(int p: backward_edges_[best]){
+            if(finish[p] >= 0){
+                ready = max(ready, finish[p] + route);
+            }
+        }
+        int s = ready + 1;
+        while(!fits(best, s)){
+            s++;
+        }
+        start[best] = s;
+        finish[best] = s + m.time_;
+        for(int t = s; t < finish[best]; t++){
+            if(m.type_ == MIXER){
+                if(t >= (int)area_used.size()){
+                    area_used.resize(t + 1, 0);
+                }
+                area_used[t] += (modules_[m.label_].w + 1) * (modules_[m.label_].h + 1);
+            }else{
+                vector<bool>& detector = busy[m.label_];
+                if(t >= (int)detector.size()){
+                    detector.resize(t + 1, false);
+                }
+                detector[t] = true;
+            }
+        }
+        for(int n: forward_edges_[best]){
+            waiting[n]--;
+        }
+    }
+
+    // droplet windows: from the step it can appear to the last step its consumer may take it
+    deadline_.assign(edges_.size(), 0);
+    int horizon = 1;
+    for(size_t i = 0; i < edges_.size(); i++){
+        int from = edges_[i].first, to = edges_[i].second;
+        int appear = finish[from] >= 0 ? finish[from] : 1;
+        if(nodes_[to].type_ == SINK){
+            deadline_[i] = appear + route + spare;
+            horizon = max(horizon, deadline_[i] + 1); // gone at the last step
+        }else{
+            deadline_[i] = start[to] - 1 + spare;
+            if(finish[from] < 0){
+                // no need to dispense long before it is used
+                appear = max(1, start[to] - 1 - route - spare);
+            }
+        }
+        earliest_[i] = max(earliest_[i], appear);
+    }
+    for(size_t i = 0; i < edges_.size(); i++){
+        horizon = max(horizon, deadline_[i] + 1);
+    }
+    for(size_t i = 0; i < edges_.size(); i++){
+        slack_[i] = horizon - deadline_[i];
+    }
+    return horizon;
+}
+
+int Architecture::min_time(){
+    // every droplet has to appear, so its window cannot be empty
+    int res = 1;
+    for(size_t i = 0; i < edges_.size(); i++){
+        res = max(res, earliest_[i] + slack_[i]);
+    }
+    return res;
+}
+
+string Architecture::canonical() const {
+    ostringstream out;
+    for(auto& m: nodes_){
+        const Module& module = modules_.at(m.label_);
+        out << "node " << m.type_ << ' ' << m.time_ << ' ' << m.drops_ << ' ' << module.id_ << '\n';
+        if(module.id_ == m.id_){
+            out << "module " << module.w << ' ' << module.h << ' ' << module.desired_amount_ << '\n';
+        }
+    }
+    // not sorted, droplet ids are edge indices
+    for(auto& e: edges_){
+        out << "edge " << e.first << ' ' << e.second << '\n';
+    }
+    return out.str();
+}
@@ -0,0 +1,122 @@
+#include "DriverUtil.h"
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+bool parse_int(const char* s, int& value){
+    char* end;
+    long v = strtol(s, &end, 10);
+    if(*s == '\0' || *end != '\0'){
+        return false;
+    }
+    value = (int)v;
+    return true;
+}
+
+int parse_solver_option(int argc, char* argv[], int& i, SolverOptions& opts){
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if(arg == "--symmetry"){
+        opts.symmetry_breaking_ = true;
+    }else if(arg == "--sparse-actions"){
+        opts.sparse_actions_ = true;
+    }else if(arg == "--decompose"){
+        opts.decompose_ = true;
+    }else if(arg == "--backend" && has_value){
+        string b = argv[++i];
+        if(b == "optimize"){
+            opts.backend_ = OPTIMIZE;
+        }else if(b == "sat"){
+            opts.backend_ = SAT;
+        }else{
+            cerr << "Unknown backend: " << b << endl;
+            return -1;
+        }
+    }else if(arg == "--objective" && has_value){
+        string o = argv[++i];
+        if(o == "feasible"){
+            opts.objective_ = FEASIBLE;
+        }else if(o == "minimize"){
+            opts.objective_ = MINIMIZE;
+        }else if(o == "staged"){
+            opts.objective_ = STAGED;
+        }else{
+            cerr << "Unknown objective: " << o << endl;
+            return -1;
+        }
+    }else if(arg == "--stage-budget" || arg == "--check-timeout" || arg == "--retries" || arg == "--max-memory"
+            || arg == "--window" || arg == "--overlap"){
+        int value;
+        if(!has_value || !parse_int(argv[++i], value)){
+            cerr << "Expected a number after " << arg << endl;
+            return -1;
+        }
+        if(arg == "--stage-budget") opts.stage_budget_ms_ = value;
+        else if(arg == "--check-timeout") opts.check_timeout_ms_ = max(0, value);
+        else if(arg == "--retries") opts.check_retries_ = max(0, value);
+        else if(arg == "--max-memory") opts.max_memory_mb_ = max(0, value);
+        else if(arg == "--window") opts.window_ = value;
+        else opts.window_overlap_ = value;
+    }else{
+        return 0;
+    }
+    return 1;
+}
+
+void solver_options_usage(ostream& out){
+    out << "  --backend <b>       optimize | sat" << endl
+        << "  --objective <o>     feasible | minimize | staged" << endl
+        << "  --stage-budget <ms> time spent reducing actions with --objective staged" << endl
+        << "  --symmetry          break symmetries of the layout and the droplet order" << endl
+        << "  --sparse-actions    action variables only for the nodes that act, another path for z3::optimize" << endl
+        << "  --check-timeout <ms> time for one candidate, one that runs out is retried with twice the time, then skipped" << endl
+        << "  --retries <n>       retries of a candidate that ran out of time (default: 1)" << endl
+        << "  --max-memory <mb>   memory z3 may use per assay" << endl
+        << "  --decompose         schedule the operations first, then place and route a window of steps at a time" << endl
+        << "  --window <n>        steps per window with --decompose (default: 12)" << endl
+        << "  --overlap <n>       steps a window shares with the next one, which are not fixed yet (default: 4)" << endl;
+}
+
+bool expand_inputs(const vector<string>& inputs, vector<string>& files){
+    for(auto& input: inputs){
+        struct stat st;
+        if(stat(input.c_str(), &st) != 0){
+            cerr << "No such file or directory: " << input << endl;
+            return false;
+        }
+        if(!S_ISDIR(st.st_mode)){
+            files.push_back(input);
+            continue;
+        }
+
+        DIR* dir = opendir(input.c_str());
+        if(dir == nullptr){
+            cerr << "Cannot open directory: " << input << endl;
+            return false;
+        }
+        vector<string> entries;
+        while(struct dirent* entry = readdir(dir)){
+            string name = entry->d_name;
+            string ext = name.substr(name.find_last_of('.') + 1);
+            if(name[0] == '.' || ext == "dot" || ext == "png"){
+                continue;
+            }
+            string path = input + "/" + name;
+            if(stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)){
+                entries.push_back(path);
+            }
+        }
+        closedir(dir);
+        sort(entries.begin(), entries.end());
+        files.insert(files.end(), entries.begin(), entries.end());
+    }
+    return true;
+}
@@ -0,0 +1,99 @@
+#include "SolutionCache.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <functional>
+
+using namespace std;
+
+#define CACHE_MAGIC "dmfb-cache 1"
+
+SolutionCache::SolutionCache(const string& dir, const string& key): dir_(dir), key_(key) {
+    // 64-bit FNV-1a
+    unsigned long long h = 14695981039346656037ull;
+    for(char c: key_){
+        h ^= (unsigned char)c;
+        h *= 1099511628211ull;
+    }
+    char buf[20];
+    sprintf(buf, "%016llx", h);
+    hash_ = buf;
+}
+
+string SolutionCache::path(int width, int height, int time){
+    return dir_ + "/" + hash_ + "-" + to_string(width) + "x" + to_string(height) + "x" + to_string(time) + ".cache";
+}
+
+static bool read_ints(istream& in, vector<int>& v){
+    size_t n;
+    if(!(in >> n)){
+        return false;
+    }
+    v.resize(n);
+    for(size_t i = 0; i < n; i++){
+        if(!(in >> v[i])){
+            return false;
+        }
+    }
+    return true;
+}
+
+static void write_ints(ostream& out, const vector<int>& v){
+    out << v.size();
+    for(int x: v){
+        out << ' ' << x;
+    }
+    out << '\n';
+}
+
+bool SolutionCache::load(int width, int height, int time, CachedSolution& res){
+    ifstream in(path(width, height, time), ios::binary);
+    if(!in.is_open()){
+        return false;
+    }
+    string magic, verdict;
+    size_t key_size;
+    if(!getline(in, magic) || magic != CACHE_MAGIC || !(in >> key_size) || key_size != key_.size() || in.get() != '\n'){
+        return false;
+    }
+    string key(key_size, '\0');
+    if(!in.read(&key[0], key_size) || key != key_ || !(in >> verdict)){
+        return false;
+    }
+
+    res.sat_ = verdict == "sat";
+    if(!res.sat_){
+        return verdict == "unsat";
+    }
+    return read_ints(in, res.ports_) && read_ints(in, res.detectors_) && read_ints(in, res.cells_)
+        && res.ports_.size() == (size_t)(width + height) * 2
+        && res.detectors_.size() == (size_t)width * height
+        && res.cells_.size() == (size_t)(time + 1) * width * height;
+}
+
+void SolutionCache::store(int width, int height, int time, const CachedSolution& sol){
+    string final_path = path(width, height, time);
+    // unique per thread and moment, readers never see a partial entry
+    ostringstream tmp;
+    tmp << final_path << ".tmp" << hash<thread::id>()(this_thread::get_id()) << "-" << chrono::steady_clock::now().time_since_epoch().count();
+
+    ofstream out(tmp.str(), ios::binary);
+    if(!out.is_open()){
+        return;
+    }
+    out << CACHE_MAGIC << '\n' << key_.size() << '\n' << key_ << (sol.sat_ ? "sat" : "unsat") << '\n';
+    if(sol.sat_){
+        write_ints(out, sol.ports_);
+        write_ints(out, sol.detectors_);
+        write_ints(out, sol.cells_);
+    }
+    out.close();
+    if(out.fail() || rename(tmp.str().c_str(), final_path.c_str()) != 0){
+        remove(tmp.str().c_str());
+    }
+}
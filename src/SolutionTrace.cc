@@ -0,0 +1,245 @@
+#include "SolutionTrace.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <cstring>
+
+using namespace std;
+
+static void put_varint(string& out, unsigned long long v){
+    while(v >= 0x80){
+        out += (char)(0x80 | (v & 0x7f));
+        v >>= 7;
+    }
+    out += (char)v;
+}
+
+// false at the end of the data or on a varint that does not fit
+static bool get_varint(const unsigned char*& p, const unsigned char* end, unsigned long long& v){
+    v = 0;
+    for(int shift = 0; shift < 63; shift += 7){
+        if(p >= end){
+            return false;
+        }
+        unsigned char b = *p++;
+        v |= (unsigned long long)(b & 0x7f) << shift;
+        if(!(b & 0x80)){
+            return true;
+        }
+    }
+    return false;
+}
+
+bool write_trace(const string& filename, int width, int height, int time, const vector<int>& cells,
+                 const vector<Node>& sink_dispensers, const vector<vector<pair<bool, string>>>& detectors){
+    // every label once, referred to by index
+    vector<string> labels;
+    map<string, int> label_index;
+    auto index_of = [&](const string& label){
+        auto it = label_index.find(label);
+        if(it != label_index.end()){
+            return it->second;
+        }
+        labels.push_back(label);
+        return label_index[label] = labels.size() - 1;
+    };
+    string placements;
+    for(auto& node: sink_dispensers){
+        put_varint(placements, node.type_);
+        put_varint(placements, node.type_ == 0 ? 0 : index_of(node.label_) + 1);
+    }
+    for(int y = 0; y < height; y++){
+        for(int x = 0; x < width; x++){
+            put_varint(placements, detectors[y][x].first ? index_of(detectors[y][x].second) + 1 : 0);
+        }
+    }
+
+    string out = TRACE_MAGIC;
+    put_varint(out, width);
+    put_varint(out, height);
+    put_varint(out, time + 1);
+    put_varint(out, labels.size());
+    for(auto& label: labels){
+        put_varint(out, label.size());
+        out += label;
+    }
+    out += placements;
+
+    int size = width * height;
+    for(int t = 0; t <= time; t++){
+        const int* cur = &cells[t * size];
+        const int* prev = cur - size;
+        int changed = 0;
+        if(t > 0){
+            for(int k = 0; k < size; k++){
+                changed += cur[k] != prev[k];
+            }
+        }
+        // a delta costs two numbers per cell, past half the grid a key frame is smaller
+        if(t % TRACE_KEY_INTERVAL == 0 || changed * 2 >= size){
+            out += (char)TRACE_KEY;
+            for(int k = 0; k < size; k++){
+                put_varint(out, cur[k] + 3);
+            }
+        }else{
+            out += (char)TRACE_DELTA;
+            put_varint(out, changed);
+            int last = 0;
+            for(int k = 0; k < size; k++){
+                if(cur[k] != prev[k]){
+                    put_varint(out, k - last);
+                    put_varint(out, cur[k] + 3);
+                    last = k;
+                }
+            }
+        }
+    }
+
+    ofstream file(filename, ios::binary);
+    if(!file.is_open()){
+        return false;
+    }
+    file.write(out.data(), out.size());
+    file.close();
+    return !file.fail();
+}
+
+bool TraceReader::open(const unsigned char* data, size_t size){
+    data_ = data;
+    end_ = data + size;
+    frames_.clear();
+    key_.clear();
+    cells_.clear();
+    sink_dispensers_.clear();
+    detectors_.clear();
+    cur_ = -1;
+    error_.clear();
+
+    size_t magic = strlen(TRACE_MAGIC);
+    if(size < magic || memcmp(data, TRACE_MAGIC, magic) != 0){
+        error_ = "not a solution trace";
+        return false;
+    }
+    const unsigned char* p = data + magic;
+    unsigned long long width, height, frames, no_of_labels;
+    if(!get_varint(p, end_, width) || !get_varint(p, end_, height) || !get_varint(p, end_, frames) || !get_varint(p, end_, no_of_labels)
+            || width == 0 || height == 0 || width * height > (1 << 24) || frames == 0 || frames > (1 << 24) || no_of_labels > size){
+        error_ = "bad trace header";
+        return false;
+    }
+    width_ = width;
+    height_ = height;
+
+    vector<string> labels;
+    for(unsigned long long i = 0; i < no_of_labels; i++){
+        unsigned long long len;
+        if(!get_varint(p, end_, len) || len > (unsigned long long)(end_ - p)){
+            error_ = "truncated trace";
+            return false;
+        }
+        labels.push_back(string((const char*)p, len));
+        p += len;
+    }
+    auto label = [&](unsigned long long idx, string& res){
+        if(idx > labels.size()){
+            return false;
+        }
+        res = idx == 0 ? "" : labels[idx - 1];
+        return true;
+    };
+
+    sink_dispensers_.resize((width_ + height_) * 2);
+    for(auto& node: sink_dispensers_){
+        unsigned long long type, idx;
+        if(!get_varint(p, end_, type) || !get_varint(p, end_, idx) || type > 2 || !label(idx, node.label_)){
+            error_ = "bad placement in trace";
+            return false;
+        }
+        node.type_ = type;
+    }
+    detectors_.assign(height_, vector<pair<bool, string>>(width_, make_pair(false, "")));
+    for(int y = 0; y < height_; y++){
+        for(int x = 0; x < width_; x++){
+            unsigned long long idx;
+            if(!get_varint(p, end_, idx) || !label(idx, detectors_[y][x].second)){
+                error_ = "bad placement in trace";
+                return false;
+            }
+            detectors_[y][x].first = idx != 0;
+        }
+    }
+
+    // index the frames, skipping over their cells
+    int cells = width_ * height_;
+    for(unsigned long long t = 0; t < frames; t++){
+        if(p >= end_ || *p > TRACE_DELTA || (t == 0 && *p != TRACE_KEY)){
+            error_ = "bad frame " + to_string(t) + " in trace";
+            return false;
+        }
+        frames_.push_back(p);
+        key_.push_back(*p == TRACE_KEY ? t : key_.back());
+        unsigned long long n = cells, v;
+        bool delta = *p++ == TRACE_DELTA;
+        bool ok = !delta || get_varint(p, end_, n);
+        for(unsigned long long k = 0; ok && k < n * (delta ? 2 : 1); k++){
+            ok = get_varint(p, end_, v);
+        }
+        if(!ok){
+            error_ = "truncated trace";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TraceReader::apply(int t){
+    const unsigned char* p = frames_[t];
+    int size = width_ * height_;
+    unsigned long long v, gap, n;
+    if(*p++ == TRACE_KEY){
+        cells_.resize(size);
+        for(int k = 0; k < size; k++){
+            get_varint(p, end_, v);
+            cells_[k] = (int)v - 3;
+        }
+    }else{
+        get_varint(p, end_, n);
+        unsigned long long k = 0;
+        for(unsigned long long i = 0; i < n; i++){
+            get_varint(p, end_, gap);
+            get_varint(p, end_, v);
+            k += gap;
+            if(k >= (unsigned long long)size){
+                error_ = "bad delta in frame " + to_string(t);
+                return false;
+            }
+            cells_[k] = (int)v - 3;
+        }
+    }
+    cur_ = t;
+    return true;
+}
+
+bool TraceReader::frame(int t, vector<vector<int>>& grid){
+    if(t < 0 || t >= (int)frames_.size()){
+        return false;
+    }
+    // forward from the current frame if no key frame is closer
+    int from = cur_ >= key_[t] && cur_ <= t ? cur_ + 1 : key_[t];
+    for(int k = from; k <= t; k++){
+        if(!apply(k)){
+            cur_ = -1;
+            return false;
+        }
+    }
+
+    grid.assign(height_, vector<int>(width_));
+    for(int y = 0; y < height_; y++){
+        for(int x = 0; x < width_; x++){
+            grid[y][x] = cells_[y*width_ + x];
+        }
+    }
+    return true;
+}
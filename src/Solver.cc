@@ -6,7 +6,17 @@
 #include <fstream>
 #include <iostream>
 #include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
 #include <chrono>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <unordered_set>
+#include <limits>
+#include <cmath>
 
 using namespace std;
 using namespace z3;
@@ -16,82 +26,317 @@ using namespace z3;
 const int dx[] = {-1, 0, 1, 0, 0};
 const int dy[] = { 0,-1, 0, 1, 0};
 
-Solver::Solver(Architecture& arch, z3::context& c): arch_(arch), ctx_(c), solver_(c), no_of_actions_(c), optimize_handle_(1), model_(c) {
+const char* phase_name(Phase phase){
+    static const char* names[NO_OF_PHASES] = {"init", "extend", "placement", "symmetry", "consistency", "movement", "fluidic", "horizon", "check", "decode"};
+    return names[phase];
+}
+
+Solver::Solver(Architecture& arch, z3::context& c): arch_(arch), ctx_(c), solver_(c), sat_solver_(c, "QF_FD"), no_of_aux_(0), no_of_assertions_(0), actions_(c), no_of_actions_(c), optimize_handle_(1), model_(c), fixed_(c), hint_width_(0), hint_height_(0), hint_time_(0), check_budget_ms_(0), interrupted_(false) {
+    decoded_ = false;
+    result_ = unknown;
+    phase_ = PHASE_INIT;
     // read width, height, ...
     width_limit_ = arch_.width_limit_;
     height_limit_ = arch_.height_limit_;
     time_limit_ = arch.time_limit_;
+
+    width_built_ = height_built_ = -1;
+    time_cur_ = 0;
 }
 
 bool Solver::solve(){
-    try {
-        for(int width = 3; width <= width_limit_; width++){
-            for(int height = 3; height <= height_limit_; height++){
-                for(int time = 5; time <= time_limit_; time++){
-                    init(width, height, time);
-                    add_constraints();
+    auto before = chrono::high_resolution_clock::now();
+    vector<pair<int, int>> grids = candidate_grids();
+    int min_time = max(1, arch_.min_time());
+    double best = numeric_limits<double>::infinity();
+    CachedSolution best_sol;
+    int best_width = -1, best_height = -1, best_time = -1;
+    for(size_t k = 0; k < grids.size() && !interrupted_; k++){
+        int width = grids[k].first, height = grids[k].second;
+        // in order of their least cost, so no grid from here on can beat the best one
+        if(grid_cost(width, height, min_time) >= best){
+            break;
+        }
+        int time_hi = max_useful_time(width, height, best);
+        if(time_hi == 0 || !solve_grid(width, height, time_hi)){
+            continue;
+        }
+        best = grid_cost(width, height, time_cur_);
+        best_width = width;
+        best_height = height;
+        best_time = time_cur_;
+        // kept in case a later grid is tried and does worse
+        decode_model();
+        best_sol.cells_ = cells_;
+        best_sol.ports_ = ports_;
+        best_sol.detectors_ = detectors_;
+    }
+    if(best_width < 0){
+        return false;
+    }
+    if(best_width != width_cur_ || best_height != height_cur_ || best_time != time_cur_ || result_ != sat){
+        set_solution(best_width, best_height, best_time, best_sol);
+    }
+    auto time_used = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - before).count();
+    cout << "Sat** - (w=" << width_cur_ << ", h=" << height_cur_ << ", t=" << time_cur_ << ") " << "--Used " << time_used << "ms" << endl;
+    cout << endl;
+    return true;
+}
 
-                    auto before = chrono::high_resolution_clock::now();
-                    result_ = solver_.check();
-                    auto after = chrono::high_resolution_clock::now();
-                    auto time_used = chrono::duration_cast<chrono::milliseconds>(after - before).count();
-                    if(result_ == sat){
-                        model_ = solver_.get_model();
-                        cout << "Sat** - (w=" << width << ", h=" << height << ", t=" << time << ") " << "--Used " << time_used << "ms" << endl;
-                        cout << endl;
-                        return true;
-                    }else{
-                        cout << "Unsat - (w=" << width << ", h=" << height << ", t=" << time << ") " << "--Used " << time_used << "ms" << endl;
-                    }
+vector<pair<int, int>> Solver::candidate_grids(){
+    // every mixer has to fit as it is, they are never rotated
+    int min_width = 3, min_height = 3;
+    for(auto& pair: arch_.modules_){
+        if(pair.second.type_ == MIXER){
+            min_width = max(min_width, pair.second.w);
+            min_height = max(min_height, pair.second.h);
+        }
+    }
+    int min_time = max(1, arch_.min_time());
+    vector<pair<double, pair<int, int>>> order;
+    for(int width = min_width; width <= width_limit_; width++){
+        for(int height = min_height; height <= height_limit_; height++){
+            order.push_back(make_pair(grid_cost(width, height, min_time), make_pair(width, height)));
+        }
+    }
+    // ties go to the squarer grid, then the narrower one
+    stable_sort(order.begin(), order.end(), [](const pair<double, pair<int, int>>& a, const pair<double, pair<int, int>>& b){
+        if(a.first != b.first){
+            return a.first < b.first;
+        }
+        return abs(a.second.first - a.second.second) < abs(b.second.first - b.second.second);
+    });
+    vector<pair<int, int>> res;
+    for(auto& o: order){
+        res.push_back(o.second);
+    }
+    return res;
+}
+
+double Solver::grid_cost(int width, int height, int time){
+    return options_.grid_cost_ ? options_.grid_cost_(width, height, time) : (double)width * height;
+}
+
+int Solver::max_useful_time(int width, int height, double best){
+    int time = time_limit_;
+    while(time > 0 && grid_cost(width, height, time) >= best){
+        time--;
+    }
+    return time;
+}
+
+bool Solver::solve_grid(int width, int height, int time_hi){
+    if(options_.decompose_){
+        return solve_decomposed(width, height, time_hi);
+    }
+    return solve_min_time(width, height, 1, time_hi);
+}
+
+bool Solver::solve_decomposed(int width, int height, int time_hi){
+    auto before = chrono::high_resolution_clock::now();
+    // a tight schedule first, operations may run later than scheduled by more on every retry.
+    // Shorter routes between operations when that no longer fits the horizon
+    int base = max(2, (width + height) / 4);
+    for(int route = base; route >= 0 && !interrupted_; route = route > 1 ? route / 2 : route - 1){
+        int step = max(1, route);
+        for(int spare = 0; spare <= 4 * step && !interrupted_; spare = spare == 0 ? step : spare * 2){
+            Architecture scheduled(arch_);
+            int horizon = scheduled.schedule(width, height, route, spare);
+            if(horizon > time_hi){
+                break; // more spare steps only make it longer
+            }
+            bool is_sat = false;
+            try {
+                is_sat = place_and_route(scheduled, width, height, horizon);
+            } catch(z3::exception& e){
+                if(!interrupted_){
+                    cout << "Unknown - (w=" << width << ", h=" << height << ", t=" << horizon << ") " << e.msg() << endl;
                 }
             }
-        }    
-    } catch(z3::exception e){
-        cerr << e.msg() << endl;
-        return true;
+            if(interrupted_){
+                return false;
+            }
+            if(is_sat){
+                auto time_used = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - before).count();
+                if(progress_){
+                    progress_(width, height, horizon, time_used, true, "");
+                }
+                cout << "Sat - (w=" << width << ", h=" << height << ", t=" << horizon << ")" << "--used " << time_used << "ms (decomposed)" << endl;
+                return true;
+            }
+        }
     }
-    return false;
+    if(interrupted_){
+        return false;
+    }
+    // the schedules are a heuristic, that none of them worked proves nothing
+    cout << "Unknown - (w=" << width << ", h=" << height << ") no schedule within t=" << time_hi << " could be placed and routed, solving in one pass" << endl;
+    return solve_min_time(width, height, 1, time_hi);
 }
 
-bool Solver::solve(int width, int height, int time){
-    try {
-        init(width, height, time);
-        add_constraints();
-
-        auto before = chrono::high_resolution_clock::now();
-        result_ = solver_.check();
-        auto after = chrono::high_resolution_clock::now();
-        auto time_used = chrono::duration_cast<chrono::milliseconds>(after - before).count();
-        if(result_ == sat){
-            model_ = solver_.get_model();
-            cout << "Sat - (w=" << width << ", h=" << height << ", t=" << time << ")" << "--used " << time_used << "ms" << endl;
+bool Solver::place_and_route(Architecture& scheduled, int width, int height, int horizon){
+    int window = max(2, options_.window_);
+    int overlap = min(max(0, options_.window_overlap_), window - 1);
+    // same context, so interrupt() reaches its checks
+    Solver sub(scheduled, ctx_);
+    sub.set_options(options_);
+    sub.check_budget_ms_ = options_.check_timeout_ms_;
+    sub.init(width, height);
+    vector<int> fixed_steps; // fixed_to and the size of sub.fixed_ before each window was fixed
+    vector<unsigned> fixed_sizes;
+    int fixed_to = 0; // steps up to here are fixed
+    int held = 0;     // steps a window keeps free besides the overlap, grows on every failure
+    int to = min(horizon, window);
+    bool is_sat = false;
+    while(!interrupted_){
+        sub.extend(to);
+        sub.check();
+        bool window_sat = sub.result_ == sat;
+        cout << (window_sat ? "Sat" : sub.result_ == unsat ? "Unsat" : "Unknown") << " - (w=" << width << ", h=" << height << ") steps " << fixed_to + 1 << ".." << to << " of " << horizon << endl;
+        if(!window_sat){
+            if(fixed_steps.empty() || sub.result_ != unsat){
+                break;
+            }
+            // free the window fixed last, the failed one is solved again together with it
+            fixed_to = fixed_steps.back();
+            sub.fixed_.resize(fixed_sizes.back());
+            fixed_steps.pop_back();
+            fixed_sizes.pop_back();
+            held += window - overlap;
+            continue;
+        }
+        if(to == horizon){
+            is_sat = true;
+            break;
+        }
+        int upto = to - overlap - held;
+        if(upto > fixed_to){
+            fixed_steps.push_back(fixed_to);
+            fixed_sizes.push_back(sub.fixed_.size());
+            sub.fix_steps(fixed_to + 1, upto);
+            fixed_to = upto;
+        }
+        to = min(horizon, to + window - overlap);
+    }
+    stats_.add(sub.get_stats());
+    if(!is_sat || interrupted_){
+        return false;
+    }
+    sub.decode_model();
+    CachedSolution sol;
+    sol.cells_.swap(sub.cells_);
+    sol.ports_.swap(sub.ports_);
+    sol.detectors_.swap(sub.detectors_);
+    set_solution(width, height, horizon, sol);
+    return true;
+}
 
+bool Solver::implied_unsat(int width, int height, int time){
+    // transposing the grid maps solutions to solutions as long as every mixer is square
+    bool transposable = true;
+    for(auto& pair: arch_.modules_){
+        if(pair.second.type_ == MIXER && pair.second.w != pair.second.h){
+            transposable = false;
+        }
+    }
+    for(auto& u: unsat_){
+        int w = get<0>(u), h = get<1>(u), t = get<2>(u);
+        if(time > t){
+            continue;
+        }
+        if((width == w && height == h) || (transposable && width == h && height == w)){
             return true;
-        }else{
-            cout << "Unsat - (w=" << width << ", h=" << height << ", t=" << time << ")" << "--used " << time_used << "ms" << endl;
-            return false;
         }
-    } catch(z3::exception e){
-        cerr << e.msg() << endl;
-        return true;
     }
     return false;
 }
 
+bool Solver::solve(int width, int height, int time){
+    CheckStats record;
+    record.width_ = width;
+    record.height_ = height;
+    record.time_ = time;
+    double build_before = build_ms(), check_before = stats_.phases_[PHASE_CHECK].ms_;
+
+    auto before = chrono::high_resolution_clock::now();
+    bool implied = implied_unsat(width, height, time);
+    bool cached = !implied && load_cached(width, height, time);
+    if(implied){
+        result_ = unsat;
+    }else if(!cached){
+        check_budget_ms_ = options_.check_timeout_ms_;
+        for(int attempt = 0; ; attempt++){
+            bool out_of_time = false;
+            try {
+                // the encoding can only grow in time or go back to a marked horizon, anything else needs a fresh one
+                if(width != width_built_ || height != height_built_ || (time < time_cur_ && !rewind(time))){
+                    init(width, height);
+                    before = chrono::high_resolution_clock::now();
+                }
+                extend(time);
+                check();
+                out_of_time = result_ == unknown && reason_unknown_ != "interrupted";
+            } catch(z3::exception& e){
+                // out of memory for instance, the encoding may be half built. z3 may also throw
+                // "canceled" when interrupted, which is no more a skipped candidate than any interrupt
+                result_ = unknown;
+                reason_unknown_ = interrupted_ ? "interrupted" : e.msg();
+                width_built_ = height_built_ = -1;
+            }
+            if(!out_of_time || check_budget_ms_ == 0 || attempt >= options_.check_retries_){
+                break;
+            }
+            check_budget_ms_ *= 2;
+            cout << "Unknown - (w=" << width << ", h=" << height << ", t=" << time << ") " << reason_unknown_ << ", retrying with " << check_budget_ms_ << "ms" << endl;
+        }
+        record.z3_ = last_z3_stats_;
+        store_cached();
+    }
+    bool is_sat = result_ == sat;
+    if(result_ == unsat && !implied){
+        unsat_.push_back(make_tuple(width, height, time));
+    }
+
+    record.cached_ = cached;
+    record.implied_ = implied;
+    record.result_ = is_sat ? "sat" : result_ == unsat ? "unsat" : "unknown";
+    if(result_ == unknown){
+        record.reason_ = reason_unknown_;
+    }
+    record.build_ms_ = build_ms() - build_before;
+    record.check_ms_ = stats_.phases_[PHASE_CHECK].ms_ - check_before;
+    stats_.checks_.push_back(record);
+    auto after = chrono::high_resolution_clock::now();
+    auto time_used = chrono::duration_cast<chrono::milliseconds>(after - before).count();
+    if(progress_){
+        progress_(width, height, time, time_used, is_sat, result_ == unknown ? reason_unknown_ : "");
+    }
+    const char* from = cached ? " (cached)" : implied ? " (implied)" : "";
+    if(is_sat){
+        cout << "Sat - (w=" << width << ", h=" << height << ", t=" << time << ")" << "--used " << time_used << "ms" << from << endl;
+        return true;
+    }else if(result_ == unsat){
+        cout << "Unsat - (w=" << width << ", h=" << height << ", t=" << time << ")" << "--used " << time_used << "ms" << from << endl;
+        return false;
+    }else{
+        // skipped, the sweep goes on as if it were unsat
+        cout << "Unknown - (w=" << width << ", h=" << height << ", t=" << time << ")" << "--used " << time_used << "ms, " << reason_unknown_ << endl;
+        return false;
+    }
+}
+
 bool Solver::solve_from(int width0, int height0, int time0){
     try {
         for(int width = width0; width <= width0*2; width++){
             for(int height = height0; height <= height0*2; height++){
+                init(width, height);
                 for(int time = time0; time <= 30; time++){
-                    init(width, height, time);
-                    add_constraints();
-
                     auto before = chrono::high_resolution_clock::now();
-                    result_ = solver_.check();
+                    extend(time);
+                    bool is_sat = check();
                     auto after = chrono::high_resolution_clock::now();
                     auto time_used = chrono::duration_cast<chrono::milliseconds>(after - before).count();
-                    if(result_ == sat){
-                        model_ = solver_.get_model();
+                    if(is_sat){
                         cout << "Sat** - (w=" << width << ", h=" << height << ", t=" << time << ") " << "--Used " << time_used << "ms" << endl;
                         cout << endl;
                         return true;
@@ -101,27 +346,271 @@ bool Solver::solve_from(int width0, int height0, int time0){
                 }
             }
         }    
-    } catch(z3::exception e){
+    } catch(z3::exception& e){
         cerr << e.msg() << endl;
-        return true;
     }
     return false;
 }
 
+bool Solver::solve_min_time(int width, int height, int time_lo, int time_hi){
+    int lo = max(time_lo, arch_.min_time()) - 1; // largest horizon known to be unsat
+    int hi = -1; // smallest horizon known to be sat
+    CachedSolution best; // the solution at hi
+
+    // every probe above lo extends the encoding of lo, which is marked when it is unsat,
+    // so neither the gallop up nor the bisection down builds a grid again
+    auto probe = [&](int time){
+        if(!solve(width, height, time)){
+            if(width_built_ == width && height_built_ == height && time_cur_ == time){
+                mark_horizon();
+            }
+            return false;
+        }
+        decode_model();
+        best.cells_ = cells_;
+        best.ports_ = ports_;
+        best.detectors_ = detectors_;
+        return true;
+    };
+
+    // gallop: lo+1, lo+3, lo+7, ...
+    int step = 1;
+    while(hi < 0 && lo < time_hi && !interrupted_){
+        int time = min(lo + step, time_hi);
+        if(probe(time)){
+            hi = time;
+        }else{
+            lo = time;
+        }
+        step *= 2;
+    }
+    if(hi < 0 || interrupted_){
+        return false;
+    }
+
+    // bisect between the last unsat and the first sat horizon
+    int last = hi;
+    while(hi - lo > 1 && !interrupted_){
+        int mid = lo + (hi - lo) / 2;
+        if(probe(mid)){
+            hi = mid;
+        }else{
+            lo = mid;
+        }
+        last = mid;
+    }
+    if(interrupted_){
+        return false;
+    }
+    if(last != hi){
+        set_solution(width, height, hi, best); // solved already, the encoding is at a shorter horizon
+    }
+    return true;
+}
+
+// one grid of the portfolio, with everything z3 owns kept in its own context
+struct PortfolioTask {
+    z3::context ctx_;
+    Architecture arch_;
+    Solver solver_;
+
+    PortfolioTask(const Architecture& arch): ctx_(), arch_(arch), solver_(arch_, ctx_) {}
+};
+
+bool Solver::solve_portfolio(int threads){
+    // candidates in the order solve() tries them, with ties going the same way it has the same optimum
+    vector<pair<int, int>> grids = candidate_grids();
+    int min_time = max(1, arch_.min_time());
+    vector<double> least_cost;
+    for(auto& grid: grids){
+        least_cost.push_back(grid_cost(grid.first, grid.second, min_time));
+    }
+
+    mutex mtx;
+    size_t next = 0;
+    double best = numeric_limits<double>::infinity();
+    size_t best_idx = grids.size(); // grid of the best solution so far
+    vector<PortfolioTask*> running(grids.size(), nullptr);
+    unique_ptr<PortfolioTask> winner;
+
+    auto work = [&](){
+        while(true){
+            size_t idx;
+            int time_hi;
+            PortfolioTask* task;
+            {
+                lock_guard<mutex> lock(mtx);
+                // sorted by least cost, nothing from here on beats the best solution
+                if(next >= grids.size() || least_cost[next] >= best || interrupted_){
+                    return;
+                }
+                idx = next++;
+                time_hi = max_useful_time(grids[idx].first, grids[idx].second, best);
+                if(time_hi == 0){
+                    continue;
+                }
+                task = new PortfolioTask(arch_);
+                task->solver_.set_options(options_);
+                task->solver_.set_progress_callback(progress_);
+                task->solver_.hint_ = hint_;
+                task->solver_.hint_width_ = hint_width_;
+                task->solver_.hint_height_ = hint_height_;
+                task->solver_.hint_time_ = hint_time_;
+                running[idx] = task;
+            }
+
+            bool is_sat = task->solver_.solve_grid(grids[idx].first, grids[idx].second, time_hi);
+
+            lock_guard<mutex> lock(mtx);
+            running[idx] = nullptr;
+            stats_.add(task->solver_.get_stats());
+            double cost = is_sat ? grid_cost(grids[idx].first, grids[idx].second, task->solver_.get_time()) : 0;
+            if(is_sat && !interrupted_ && (cost < best || (cost == best && idx < best_idx))){
+                best = cost;
+                best_idx = idx;
+                winner.reset(task);
+                // the grids that can at best tie with it, and come later
+                for(size_t j = 0; j < running.size(); j++){
+                    if(running[j] != nullptr && (least_cost[j] > best || (least_cost[j] == best && j > best_idx))){
+                        running[j]->solver_.interrupt();
+                    }
+                }
+            }else{
+                delete task;
+            }
+        }
+    };
+
+    atomic<int> finished(0);
+    vector<thread> pool;
+    for(int k = 0; k < threads; k++){
+        pool.push_back(thread([&](){ work(); finished++; }));
+    }
+    // stopping this solver stops every worker
+    while(finished < threads){
+        if(interrupted_){
+            lock_guard<mutex> lock(mtx);
+            for(auto task: running){
+                if(task != nullptr){
+                    task->solver_.interrupt();
+                }
+            }
+        }
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    for(auto& th: pool){
+        th.join();
+    }
+
+    if(!winner){
+        return false;
+    }
+    load_solution(winner->solver_);
+    return true;
+}
+
+void Solver::interrupt(){
+    interrupted_ = true;
+    ctx_.interrupt();
+}
+
+void Solver::load_solution(Solver& other){
+    init(other.width_cur_, other.height_cur_);
+    extend(other.time_cur_);
+    // the decoded arrays say all there is, and other may have its solution from the cache
+    other.decode_model();
+    cells_ = other.cells_;
+    ports_ = other.ports_;
+    detectors_ = other.detectors_;
+    decoded_ = true;
+    result_ = other.result_;
+}
+
+bool Solver::set_hint(Solver& other){
+    if(other.result_ != sat || other.arch_.canonical() != arch_.canonical()){
+        return false;
+    }
+    other.decode_model();
+    hint_.sat_ = true;
+    hint_.cells_ = other.cells_;
+    hint_.ports_ = other.ports_;
+    hint_.detectors_ = other.detectors_;
+    hint_width_ = other.width_cur_;
+    hint_height_ = other.height_cur_;
+    hint_time_ = other.time_cur_;
+    return true;
+}
+
+bool Solver::load_cached(int width, int height, int time){
+    if(options_.cache_dir_.empty()){
+        return false;
+    }
+    if(!cache_){
+        ostringstream key;
+        key << arch_.canonical() << "options " << options_.backend_ << ' ' << options_.objective_ << ' '
+            << (options_.objective_ == STAGED ? options_.stage_budget_ms_ : 0) << ' ' << options_.symmetry_breaking_ << ' ' << options_.sparse_actions_ << '\n';
+        cache_.reset(new SolutionCache(options_.cache_dir_, key.str()));
+    }
+
+    CachedSolution sol;
+    if(!cache_->load(width, height, time, sol)){
+        return false;
+    }
+    if(sol.sat_){
+        set_solution(width, height, time, sol);
+    }
+    result_ = sol.sat_ ? sat : unsat;
+    return true;
+}
+
+void Solver::set_solution(int width, int height, int time, CachedSolution& sol){
+    width_cur_ = width;
+    height_cur_ = height;
+    perimeter_cur_ = (width + height) * 2;
+    time_cur_ = time;
+    cells_.swap(sol.cells_);
+    ports_.swap(sol.ports_);
+    detectors_.swap(sol.detectors_);
+    decoded_ = true;
+    result_ = sat;
+    // the encoding no longer belongs to the current grid and horizon
+    width_built_ = height_built_ = -1;
+}
+
+void Solver::store_cached(){
+    if(!cache_ || (result_ != sat && result_ != unsat)){
+        return;
+    }
+    // a hinted solution is the best one close to the hint, not the one the key stands for.
+    // An unsat verdict holds without the hint, see run_hinted_check()
+    if(result_ == sat && !hint_.cells_.empty()){
+        return;
+    }
+    CachedSolution sol;
+    sol.sat_ = result_ == sat;
+    if(sol.sat_){
+        decode_model();
+        sol.cells_ = cells_;
+        sol.ports_ = ports_;
+        sol.detectors_ = detectors_;
+    }
+    cache_->store(width_cur_, height_cur_, time_cur_, sol);
+}
+
 void Solver::print_solution(ostream& out){ 
     if(result_ == unsat){
         return;
     }
+    decode_model();
 
     out << "Solution to " << arch_.label_ << endl;
 
-    expr TRUE = ctx_.bool_val(true);
     out << "Dispenser position(s): " << endl;
-    for(auto pair: arch_.modules_){
-        Module module = pair.second;
+    for(auto& pair: arch_.modules_){
+        const Module& module = pair.second;
         if(module.type_ == DISPENSER){
             for(int p = 0; p < perimeter_cur_; p++){
-                if(eq(model_.eval(dispenser_[p][module.id_]), TRUE)){
+                if(ports_[p] == module.id_){
                     out << module.label_ << " at " << p << endl;
                 }
             }
@@ -130,11 +619,11 @@ void Solver::print_solution(ostream& out){
     out << endl;
 
     out << "Sink position(s): " << endl;
-    for(auto pair: arch_.modules_){
-        Module module = pair.second;
+    for(auto& pair: arch_.modules_){
+        const Module& module = pair.second;
         if(module.type_ == SINK){
             for(int p = 0; p < perimeter_cur_; p++){
-                if(eq(model_.eval(sink_[p][module.id_]), TRUE)){
+                if(ports_[p] == module.id_){
                     out << module.label_ << " at " << p << endl;
                 }
             }
@@ -143,12 +632,12 @@ void Solver::print_solution(ostream& out){
     out << endl;
 
     out << "Detector position(s): " << endl;
-    for(auto pair: arch_.modules_){
-        Module module = pair.second;
+    for(auto& pair: arch_.modules_){
+        const Module& module = pair.second;
         if(module.type_ == DETECTOR){
             for(int x = 0; x < width_cur_; x++){
                 for(int y = 0; y < height_cur_; y++){
-                    if(eq(model_.eval(detector_[x][y][module.id_]), TRUE)){
+                    if(detectors_[y*width_cur_ + x] == module.id_){
                         out << module.label_ << " at (" << x << ", " << y << ")" << endl;
                     }
                 }
@@ -161,32 +650,16 @@ void Solver::print_solution(ostream& out){
         out << "time = " << t << endl;
         for(int y = 0; y < height_cur_; y++){
             for(int x = 0; x < width_cur_; x++){
-                bool flag = false;
-                for(auto module: arch_.nodes_){
-                    if(module.type_ == DETECTOR){
-                        int detector_id = arch_.modules_[module.label_].id_;
-                        if(eq(model_.eval(detector_[x][y][detector_id]), TRUE) && eq(model_.eval(detecting_[t][module.id_]), TRUE)){
-                            out << "d ";
-                            flag = true;
-                            break;
-                        }
-                    }else if(module.type_ == MIXER){
-                        if(eq(model_.eval(mixing_[t][x][y][module.id_]), TRUE)){
-                            out << "m ";
-                            flag = true;
-                            break;
-                        }
-                    }
-                }
-                for(int i = 0; i < no_of_edges_; i++){
-                    if(eq(model_.eval(c_[t][x][y][i]), TRUE)){
-                        out << i << ' ';
-                        flag = true;
-                        break;
-                    }
-                }
-                if(!flag)
+                int v = cell(t, x, y);
+                if(v == -1){
+                    out << "d ";
+                }else if(v == -2){
+                    out << "m ";
+                }else if(v == -3){
                     out << "e ";
+                }else{
+                    out << v << ' ';
+                }
             }
             out << endl;
         }
@@ -194,6 +667,61 @@ void Solver::print_solution(ostream& out){
     }
 }
 
+string Solver::var_name(int symbol){
+    VarTensor* tensors[] = {nullptr, &c_, &present_, &mixing_, &detector_, &detecting_, &dispenser_, &sink_};
+    if(symbol < VarTensor::SYMBOL_BASE){
+        return "";
+    }
+    int kind = (symbol - VarTensor::SYMBOL_BASE) >> VarTensor::KIND_SHIFT;
+    int idx = symbol & ((1 << VarTensor::KIND_SHIFT) - 1);
+    if(kind == VAR_NONE || idx >= tensors[kind]->size()){
+        return "";
+    }
+
+    int a, b, c, d;
+    tensors[kind]->coords(idx, a, b, c, d);
+    char name[80];
+    switch(kind){
+        case VAR_C: sprintf(name, "c^%d_(%d,%d,%d)", a, b, c, d); break;
+        case VAR_PRESENT: sprintf(name, "present^%d_(%d)", a, b); break;
+        case VAR_MIXING: sprintf(name, "mixing^%d_(%d,%d,%d)", a, b, c, d); break;
+        case VAR_DETECTOR: sprintf(name, "detector_(%d,%d,%d)", a, b, c); break;
+        case VAR_DETECTING: sprintf(name, "detecting^%d_(%d)", a, b); break;
+        case VAR_DISPENSER: sprintf(name, "dispenser_(%d,%d)", a, b); break;
+        default: sprintf(name, "sink_(%d, %d)", a, b); break;
+    }
+    return name;
+}
+
+string Solver::with_var_names(const string& text){
+    string res;
+    res.reserve(text.size());
+    size_t i = 0;
+    while(i < text.size()){
+        size_t k = text.find("k!", i);
+        if(k == string::npos){
+            break;
+        }
+        // only a whole symbol k!<digits>, not the tail of another one
+        size_t end = k + 2;
+        while(end < text.size() && isdigit(text[end])){
+            end++;
+        }
+        bool whole = (k == 0 || !(isalnum(text[k-1]) || strchr("~!@$%^&*_-+=<>.?/", text[k-1])))
+                  && end > k + 2 && (end == text.size() || !(isalnum(text[end]) || strchr("~!@$%^&*_-+=<>.?/", text[end])));
+        string name = whole ? var_name(atoi(text.c_str() + k + 2)) : "";
+        res.append(text, i, k - i);
+        if(name.empty()){
+            res.append(text, k, end - k);
+        }else{
+            res += "|" + name + "|";
+        }
+        i = end;
+    }
+    res.append(text, min(i, text.size()), string::npos);
+    return res;
+}
+
 void Solver::save_solution(string filename){
     cout << "Printing solution to file: " << filename << endl;
     ofstream out(filename);
@@ -203,45 +731,111 @@ void Solver::save_solution(string filename){
     out.close();
 }
 
+bool Solver::save_trace(string filename){
+    if(result_ != sat){
+        return false;
+    }
+    decode_model();
+    return write_trace(filename, width_cur_, height_cur_, time_cur_, cells_, get_sink_dispenser_pos(), get_detector_pos());
+}
+
 void Solver::generate_gif(string filename){
     cout << "Generating " << filename << endl;
     
 }
 
-vector<vector<vector<int>>> Solver::get_grid(){
-    expr TRUE = ctx_.bool_val(true);
-    vector<vector<vector<int>>> res;
-    res.resize(time_cur_+1);
+void Solver::decode_model(){
+    if(decoded_){
+        return;
+    }
+    decoded_ = true;
+    PhaseScope scope(*this, PHASE_DECODE);
+
+    // one pass over the model: which constants are true, by declaration id
+    unordered_set<unsigned> is_true;
+    for(unsigned k = 0; k < model_.num_consts(); k++){
+        func_decl decl = model_.get_const_decl(k);
+        if(model_.get_const_interp(decl).is_true()){
+            is_true.insert(decl.id());
+        }
+    }
+    // variables the model leaves out are false, like eval() without completion
+    auto holds = [&](const expr& e){
+        if(!e.is_const()){
+            return false;
+        }
+        if(e.is_true()){
+            return true;
+        }
+        return is_true.count(e.decl().id()) > 0;
+    };
+
+    ports_.assign(perimeter_cur_, -1);
+    detectors_.assign(width_cur_ * height_cur_, -1);
+    for(auto& pair: arch_.modules_){
+        const Module& m = pair.second;
+        if(m.type_ == DISPENSER || m.type_ == SINK){
+            for(int p = 0; p < perimeter_cur_; p++){
+                if(holds(m.type_ == DISPENSER ? dispenser_(p, m.id_) : sink_(p, m.id_))){
+                    ports_[p] = m.id_;
+                }
+            }
+        }else if(m.type_ == DETECTOR){
+            for(int x = 0; x < width_cur_; x++){
+                for(int y = 0; y < height_cur_; y++){
+                    if(holds(detector_(x, y, m.id_))){
+                        detectors_[y*width_cur_ + x] = m.id_;
+                    }
+                }
+            }
+        }
+    }
+
+    // the mixers and detectors, with the module each detector node runs on, looked up once
+    vector<pair<int, int>> operations;
+    for(auto& node: arch_.nodes_){
+        if(node.type_ == DETECTOR){
+            operations.push_back(make_pair(node.id_, arch_.modules_[node.label_].id_));
+        }else if(node.type_ == MIXER){
+            operations.push_back(make_pair(node.id_, -1));
+        }
+    }
+
+    // detecting and mixing take precedence over a droplet in the same cell
+    cells_.assign((time_cur_ + 1) * height_cur_ * width_cur_, -3);
     for(int t = 0; t <= time_cur_; t++){
-        res[t].resize(height_cur_);
         for(int y = 0; y < height_cur_; y++){
             for(int x = 0; x < width_cur_; x++){
-                bool flag = false;
-                for(auto module: arch_.nodes_){
-                    if(module.type_ == DETECTOR){
-                        int detector_id = arch_.modules_[module.label_].id_;
-                        if(eq(model_.eval(detector_[x][y][detector_id]), TRUE) && eq(model_.eval(detecting_[t][module.id_]), TRUE)){
-                            res[t][y].push_back(-1);
-                            flag = true;
-                            break;
-                        }
-                    }else if(module.type_ == MIXER){
-                        if(eq(model_.eval(mixing_[t][x][y][module.id_]), TRUE)){
-                            res[t][y].push_back(-2);
-                            flag = true;
-                            break;
-                        }
+                int& v = cells_[(t*height_cur_ + y)*width_cur_ + x];
+                for(int i = 0; i < no_of_edges_; i++){
+                    if(holds(c_(t, x, y, i))){
+                        v = i;
+                        break;
                     }
                 }
-                for(int i = 0; i < no_of_edges_; i++){
-                    if(eq(model_.eval(c_[t][x][y][i]), TRUE)){
-                        res[t][y].push_back(i);
-                        flag = true;
+                for(auto& op: operations){
+                    if(op.second >= 0){
+                        if(detectors_[y*width_cur_ + x] == op.second && holds(detecting_(t, op.first))){
+                            v = -1;
+                            break;
+                        }
+                    }else if(holds(mixing_(t, x, y, op.first))){
+                        v = -2;
                         break;
                     }
                 }
-                if(!flag)
-                    res[t][y].push_back(-3);
+            }
+        }
+    }
+}
+
+vector<vector<vector<int>>> Solver::get_grid(){
+    decode_model();
+    vector<vector<vector<int>>> res(time_cur_+1, vector<vector<int>>(height_cur_, vector<int>(width_cur_)));
+    for(int t = 0; t <= time_cur_; t++){
+        for(int y = 0; y < height_cur_; y++){
+            for(int x = 0; x < width_cur_; x++){
+                res[t][y][x] = cell(t, x, y);
             }
         }
     }
@@ -249,52 +843,40 @@ vector<vector<vector<int>>> Solver::get_grid(){
 }
 
 std::vector<Node> Solver::get_sink_dispenser_pos(){
-    expr TRUE = ctx_.bool_val(true);
-    vector<Node> res;
+    decode_model();
+    vector<Node> res(perimeter_cur_);
     for(int p = 0; p < perimeter_cur_; p++){
-        Node node;
-        bool flag = false;
-        for(auto pair: arch_.modules_){
-            Module m = pair.second;
-            if(m.type_ == DISPENSER){
-                if(eq(model_.eval(dispenser_[p][m.id_]), TRUE)){
-                    node.type_ = 2;
-                    node.label_ = m.label_;
-                    flag = true;
-                    break;
-                }
-            }else if(m.type_ == SINK){
-                if(eq(model_.eval(sink_[p][m.id_]), TRUE)){
-                    node.type_ = 1;
-                    node.label_ = m.label_;
-                    flag = true;
-                }
-            }
+        res[p].type_ = 0;
+    }
+    for(auto& pair: arch_.modules_){
+        const Module& m = pair.second;
+        if(m.type_ != DISPENSER && m.type_ != SINK){
+            continue;
         }
-        if(!flag){
-            node.type_ = 0;
-            // node.label_ = "";
+        for(int p = 0; p < perimeter_cur_; p++){
+            if(ports_[p] == m.id_){
+                res[p].type_ = m.type_ == DISPENSER ? 2 : 1;
+                res[p].label_ = m.label_;
+            }
         }
-        res.push_back(node);
     }
-
     return res;
 }
 
 std::vector<std::vector<std::pair<bool, std::string>>> Solver::get_detector_pos(){
-    expr TRUE = ctx_.bool_val(true);
+    decode_model();
     vector<vector<pair<bool, string>>> res;
     res.resize(height_cur_);
     for(int y = 0; y < height_cur_; y++){
         res[y].resize(width_cur_, make_pair(false, ""));
     }
 
-    for(auto pair: arch_.modules_){
-        Module m = pair.second;
+    for(auto& pair: arch_.modules_){
+        const Module& m = pair.second;
         if(m.type_ == DETECTOR){
             for(int x = 0; x < width_cur_; x++){
                 for(int y = 0; y < height_cur_; y++){
-                    if(eq(model_.eval(detector_[x][y][m.id_]), TRUE)){
+                    if(detectors_[y*width_cur_ + x] == m.id_){
                         res[y][x] = make_pair(true, m.label_);
                     }
                 }
@@ -305,185 +887,697 @@ std::vector<std::vector<std::pair<bool, std::string>>> Solver::get_detector_pos(
 }
 
 
-void Solver::init(int width, int height, int time){
-    // init variables
-    c_.clear();
-    detecting_.clear();
-    mixing_.clear();
-    detector_.clear();
-    dispenser_.clear();
-    sink_.clear();
-    solver_ = optimize(ctx_);
+void Solver::init(int width, int height){
+    {
+        // drop the previous encoding before the scope below counts what this one creates
+        PhaseTimer timer(stats_.phases_[PHASE_INIT].ms_);
+        width_cur_ = width;
+        height_cur_ = height;
+        perimeter_cur_ = (width + height) * 2;
+        time_cur_ = 0;
+        width_built_ = width;
+        height_built_ = height;
+
+        no_of_modules_ = arch_.modules_.size();
+        no_of_nodes_ = arch_.nodes_.size();
+        no_of_edges_ = arch_.edges_.size();
+
+        // init variables, extend() adds the layers of the time indexed ones
+        c_.reset(VAR_C, width, height, no_of_edges_);
+        present_.reset(VAR_PRESENT, no_of_edges_);
+        mixing_.reset(VAR_MIXING, width, height, no_of_nodes_);
+        detecting_.reset(VAR_DETECTING, no_of_nodes_);
+        detector_.reset(VAR_DETECTOR, height, no_of_nodes_);
+        dispenser_.reset(VAR_DISPENSER, no_of_nodes_);
+        sink_.reset(VAR_SINK, no_of_nodes_);
+        detector_.reserve(width);
+        dispenser_.reserve(perimeter_cur_);
+        sink_.reserve(perimeter_cur_);
+        solver_ = optimize(ctx_);
+        sat_solver_ = z3::solver(ctx_, "QF_FD");
+        no_of_aux_ = 0;
+        no_of_assertions_ = 0;
+        actions_ = expr_vector(ctx_);
+        fixed_ = expr_vector(ctx_);
+        marks_.clear();
+    }
+    {
+        PhaseScope scope(*this, PHASE_INIT);
+        // nothing is on the grid at t = 0
+        expr FALSE = ctx_.bool_val(false);
+        for(int k = 0; k < c_.layer_size(); k++){
+            c_.add_const(FALSE);
+        }
+        for(int k = 0; k < present_.layer_size(); k++){
+            present_.add_const(FALSE);
+        }
+        for(int k = 0; k < mixing_.layer_size(); k++){
+            mixing_.add_const(FALSE);
+        }
+        for(int k = 0; k < detecting_.layer_size(); k++){
+            detecting_.add_const(FALSE);
+        }
 
-    width_cur_ = width;
-    height_cur_ = height;
-    perimeter_cur_ = (width + height) * 2;
-    time_cur_ = time;
+        // detector_(x,y,l), dispenser_(p,l), sink_(p,l), only for the modules l of that type
+        vector<Type> module_type(no_of_nodes_, NONE);
+        for(auto& pair: arch_.modules_){
+            module_type[pair.second.id_] = pair.second.type_;
+        }
+        for(int x = 0; x < width; x++){
+            for(int y = 0; y < height; y++){
+                for(int l = 0; l < no_of_nodes_; l++){
+                    if(module_type[l] == DETECTOR){
+                        detector_.add_var(ctx_);
+                    }else{
+                        detector_.add_const(FALSE);
+                    }
+                }
+            }
+        }
+        for(int p = 0; p < perimeter_cur_; p++){
+            for(int l = 0; l < no_of_nodes_; l++){
+                if(module_type[l] == DISPENSER){
+                    dispenser_.add_var(ctx_);
+                }else{
+                    dispenser_.add_const(FALSE);
+                }
+            }
+        }
+        for(int p = 0; p < perimeter_cur_; p++){
+            for(int l = 0; l < no_of_nodes_; l++){
+                if(module_type[l] == SINK){
+                    sink_.add_var(ctx_);
+                }else{
+                    sink_.add_const(FALSE);
+                }
+            }
+        }
+    }
+    add_placement_constraints();
+    if(options_.symmetry_breaking_){
+        add_symmetry_breaking();
+    }
+}
 
-    no_of_modules_ = arch_.modules_.size();
-    no_of_nodes_ = arch_.nodes_.size();
-    no_of_edges_ = arch_.edges_.size();
+void Solver::extend(int time){
+    int t_from = time_cur_ + 1;
+    if(time < t_from){
+        return;
+    }
+    {
+        PhaseScope scope(*this, PHASE_EXTEND);
+        int width = width_cur_;
+        int height = height_cur_;
+
+        c_.reserve(time + 1);
+        present_.reserve(time + 1);
+        mixing_.reserve(time + 1);
+        detecting_.reserve(time + 1);
+
+        // c^t_(x,y,id), in index order so every layer is appended whole
+        for(int t = t_from; t <= time; t++){
+            for(int w = 0; w < width; w++){
+                for(int h = 0; h < height; h++){
+                    // see definition of id
+                    for(int id = 0; id < no_of_edges_; id++){
+                        // the droplet cannot be here yet, or no longer by the schedule
+                        if(t < earliest(id, w, h) || (!arch_.deadline_.empty() && t > latest(id, w, h))){
+                            c_.add_const(ctx_.bool_val(false));
+                            continue;
+                        }
+                        c_.add_var(ctx_);
+                        actions_.push_back(c_(t, w, h, id));
+                    }
+                }
+            }
+        }
 
-    // count otal droplet/mixer appearance
-    expr_vector counter(ctx_);
-    // constants
-    expr zero = ctx_.int_val(0);
-    expr one = ctx_.int_val(1);
-    // c^t_(x,y,id)
-    c_.resize(time+1);
-    for(int t = 1; t <= time; t++){
-        c_[t].resize(width);
-        for(int w = 0; w < width; w++){
-            c_[t][w].resize(height);
-            for(int h = 0; h < height; h++){
-                // see definition of id
-                for(int id = 0; id < no_of_edges_; id++){
-                    char name[50];
-                    sprintf(name, "c^%d_(%d,%d,%d)", t, w, h, id); // c^t_(x,y,id)
-                    c_[t][w][h].push_back(ctx_.bool_const(name));
+        // present^t_(id)
+        for(int t = t_from; t <= time; t++){
+            for(int id = 0; id < no_of_edges_; id++){
+                expr_vector cells(ctx_);
+                for(int w = 0; w < width; w++){
+                    for(int h = 0; h < height; h++){
+                        if(!c_(t, w, h, id).is_false()){
+                            cells.push_back(c_(t, w, h, id));
+                        }
+                    }
+                }
+                if(cells.empty()){
+                    present_.add_const(ctx_.bool_val(false));
+                    continue;
+                }
+                present_.add_var(ctx_);
+                add(present_(t, id) == mk_or(cells));
+            }
+        }
 
-                    expr e = ite(c_[t][w][h][id], one, zero);
-                    counter.push_back(e);
+        // mixing^t_(x,y,id), constant false for the other nodes with sparse_actions_
+        for(int t = t_from; t <= time; t++){
+            for(int x = 0; x < width; x++){
+                for(int y = 0; y < height; y++){
+                    for(int i = 0; i < no_of_nodes_; i++){
+                        if(options_.sparse_actions_ && arch_.nodes_[i].type_ != MIXER){
+                            mixing_.add_const(ctx_.bool_val(false));
+                            continue;
+                        }
+                        mixing_.add_var(ctx_);
+                        actions_.push_back(mixing_(t, x, y, i));
+                    }
                 }
             }
         }
+
+        // detecting^t_(l), constant false for the other nodes with sparse_actions_
+        for(int t = t_from; t <= time; t++){
+            for(int i = 0; i < no_of_nodes_; i++){
+                if(options_.sparse_actions_ && arch_.nodes_[i].type_ != DETECTOR){
+                    detecting_.add_const(ctx_.bool_val(false));
+                    continue;
+                }
+                detecting_.add_var(ctx_);
+                actions_.push_back(detecting_(t, i));
+            } 
+        }
+
+        time_cur_ = time;
     }
-    c_[0].resize(width);
-    for(int w = 0; w < width; w++){
-        c_[0][w].resize(height);
-        for(int h = 0; h < height; h++){
-            c_[0][w][h].resize(no_of_edges_, ctx_.bool_val(false));
+    add_constraints(t_from, time);
+}
+
+void Solver::mark_horizon(){
+    if(!marks_.empty() && marks_.back().time_ == time_cur_){
+        return;
+    }
+    HorizonMark mark;
+    mark.time_ = time_cur_;
+    mark.no_of_actions_ = actions_.size();
+    mark.no_of_aux_ = no_of_aux_;
+    mark.no_of_assertions_ = no_of_assertions_;
+    marks_.push_back(mark);
+    push();
+}
+
+bool Solver::rewind(int time){
+    while(!marks_.empty() && marks_.back().time_ > time){
+        pop();
+        marks_.pop_back();
+    }
+    if(marks_.empty()){
+        return false;
+    }
+    // the steps after the mark, its scope stays open for the next rewind
+    HorizonMark& mark = marks_.back();
+    pop();
+    push();
+    VarTensor* tensors[] = {&c_, &present_, &mixing_, &detecting_};
+    for(auto tensor: tensors){
+        tensor->truncate(mark.time_ + 1);
+    }
+    actions_.resize(mark.no_of_actions_);
+    no_of_aux_ = mark.no_of_aux_;
+    no_of_assertions_ = mark.no_of_assertions_;
+    time_cur_ = mark.time_;
+    return true;
+}
+
+bool Solver::check(){
+    // z3::optimize minimizes on its own, everything else tightens a bound on the actions
+    bool optimize = options_.backend_ == OPTIMIZE && options_.objective_ == MINIMIZE;
+    {
+        PhaseScope scope(*this, PHASE_HORIZON);
+        // everything tied to the horizon is scoped, so the next extend() can build on top
+        push();
+        add_objectives();
+        add_time_windows();
+
+        if(optimize){
+            // add optimizing condition to solver to reduce total number of steps
+            expr zero = ctx_.int_val(0);
+            expr one = ctx_.int_val(1);
+            expr_vector counter(ctx_);
+            for(unsigned k = 0; k < actions_.size(); k++){
+                counter.push_back(ite(actions_[k], one, zero));
+            }
+            no_of_actions_ = ctx_.int_const("no_of_actions");
+            solver_.add(no_of_actions_ == sum(counter));
+            optimize_handle_ = solver_.minimize(no_of_actions_);
         }
     }
 
-    // mixing^t_(x,y,id)
-    mixing_.resize(time+1);
-    for(int t = 0; t <= time; t++){
-        mixing_[t].resize(width);
-        for(int x = 0; x < width; x++){
-            mixing_[t][x].resize(height);
-            for(int y = 0; y < height; y++){
-                for(int i = 0; i < no_of_nodes_; i++){
-                    char name[80];
-                    sprintf(name, "mixing^%d_(%d,%d,%d)", t, x, y, i);
-                    mixing_[t][x][y].push_back(ctx_.bool_const(name));
+    PhaseScope scope(*this, PHASE_CHECK);
+    try {
+        set_timeout(check_budget_ms_);
+        auto start = chrono::steady_clock::now();
+        result_ = hint_.cells_.empty() ? run_check() : run_hinted_check();
+        if(result_ == unknown){
+            // z3 does not always say "timeout", optimize may only say "unknown"
+            auto used = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+            if(interrupted_){
+                reason_unknown_ = "interrupted";
+            }else if(check_budget_ms_ > 0 && used >= check_budget_ms_){
+                reason_unknown_ = "timeout";
+            }else{
+                reason_unknown_ = options_.backend_ == SAT ? sat_solver_.reason_unknown() : string(Z3_optimize_get_reason_unknown(ctx_, solver_));
+            }
+        }else if(result_ == sat && !optimize && options_.objective_ != FEASIBLE){
+            tighten_actions(options_.objective_ == STAGED ? options_.stage_budget_ms_ : 0);
+        }
+        record_z3_stats();
+    } catch(z3::exception&){
+        pop();
+        throw;
+    }
+    pop();
+    return result_ == sat;
+}
 
-                    counter.push_back(ite(mixing_[t][x][y][i], one, zero));
-                }
+void Solver::record_z3_stats(){
+    z3::stats st = options_.backend_ == SAT ? sat_solver_.statistics() : solver_.statistics();
+    last_z3_stats_.clear();
+    for(unsigned k = 0; k < st.size(); k++){
+        last_z3_stats_.push_back(make_pair(st.key(k), st.is_uint(k) ? (double)st.uint_value(k) : st.double_value(k)));
+    }
+}
+
+double Solver::build_ms(){
+    double res = 0;
+    for(int p = 0; p < PHASE_CHECK; p++){
+        res += stats_.phases_[p].ms_;
+    }
+    return res;
+}
+
+string json_string(const string& s){
+    string res = "\"";
+    for(char c: s){
+        if(c == '"' || c == '\\'){
+            res += '\\';
+            res += c;
+        }else if((unsigned char)c < 0x20){
+            char buf[8];
+            sprintf(buf, "\\u%04x", c);
+            res += buf;
+        }else{
+            res += c;
+        }
+    }
+    return res + "\"";
+}
+
+void SolverStats::add(const SolverStats& other){
+    for(int p = 0; p < NO_OF_PHASES; p++){
+        phases_[p].ms_ += other.phases_[p].ms_;
+        phases_[p].assertions_ += other.phases_[p].assertions_;
+        phases_[p].vars_ += other.phases_[p].vars_;
+    }
+    checks_.insert(checks_.end(), other.checks_.begin(), other.checks_.end());
+}
+
+int SolverStats::no_of_skipped() const {
+    int res = 0;
+    for(auto& cs: checks_){
+        res += cs.result_ == "unknown" && cs.reason_ != "interrupted";
+    }
+    return res;
+}
+
+string SolverStats::to_json() const {
+    ostringstream out;
+    out << "{\"phases\": {";
+    for(int p = 0; p < NO_OF_PHASES; p++){
+        const PhaseStats& ps = phases_[p];
+        out << (p ? ", " : "") << "\"" << phase_name((Phase)p) << "\": {\"ms\": " << ps.ms_
+            << ", \"assertions\": " << ps.assertions_ << ", \"vars\": " << ps.vars_ << "}";
+    }
+    out << "}, \"checks\": [";
+    for(size_t k = 0; k < checks_.size(); k++){
+        const CheckStats& cs = checks_[k];
+        out << (k ? ", " : "") << "{\"width\": " << cs.width_ << ", \"height\": " << cs.height_ << ", \"time\": " << cs.time_
+            << ", \"result\": \"" << cs.result_ << "\", \"reason\": " << json_string(cs.reason_) << ", \"cached\": " << (cs.cached_ ? "true" : "false") << ", \"implied\": " << (cs.implied_ ? "true" : "false")
+            << ", \"build_ms\": " << cs.build_ms_ << ", \"check_ms\": " << cs.check_ms_ << ", \"z3\": {";
+        for(size_t i = 0; i < cs.z3_.size(); i++){
+            out << (i ? ", " : "") << json_string(cs.z3_[i].first) << ": " << cs.z3_[i].second;
+        }
+        out << "}}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+int Solver::get_no_of_vars(){
+    VarTensor* tensors[] = {&c_, &present_, &mixing_, &detector_, &detecting_, &dispenser_, &sink_};
+    int res = no_of_aux_;
+    for(auto tensor: tensors){
+        res += tensor->no_of_vars();
+    }
+    return res;
+}
+
+int Solver::count_actions(){
+    int res = 0;
+    for(unsigned k = 0; k < actions_.size(); k++){
+        if(model_.eval(actions_[k]).is_true()){
+            res++;
+        }
+    }
+    return res;
+}
+
+void Solver::fix_steps(int t_from, int t_to){
+    VarTensor* tensors[] = {&c_, &mixing_, &detecting_};
+    for(auto tensor: tensors){
+        int size = tensor->layer_size();
+        for(int k = t_from * size; k < (t_to + 1) * size; k++){
+            expr v = (*tensor)[k];
+            if(!v.is_const() || v.is_true() || v.is_false()){
+                continue;
             }
+            fixed_.push_back(model_.eval(v, true).is_true() ? v : !v);
         }
     }
-    mixing_[0].resize(width);
-    for(int w = 0; w < width; w++){
-        mixing_[0][w].resize(height);
-        for(int h = 0; h < height; h++){
-            mixing_[0][w][h].resize(no_of_nodes_, ctx_.bool_val(false));
+}
+
+void Solver::tighten_actions(int budget_ms){
+    auto start = chrono::steady_clock::now();
+    // linear descent on the bound, every step keeps the clauses learnt so far
+    int bound = count_actions();
+    while(bound > 0){
+        if(budget_ms > 0){
+            long long left = budget_ms - chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+            if(left <= 0){
+                break;
+            }
+            set_timeout(check_budget_ms_ > 0 ? min<long long>(left, check_budget_ms_) : left);
         }
+
+        push();
+        // both backends handle this one natively, a sequential counter over every action
+        // variable would need actions * bound auxiliary variables
+        add(atmost(actions_, bound - 1));
+        check_result res = run_check(); // keeps the last model unless sat
+        pop();
+        if(res != sat){
+            break;
+        }
+        bound = count_actions();
     }
+    set_timeout(check_budget_ms_);
+}
 
-    // detecting^t_(l)
-    detecting_.resize(time+1);
-    detecting_[0].resize(no_of_nodes_, ctx_.bool_val(false));
-    for(int t = 1; t <= time; t++){
-        for(int i = 0; i < no_of_nodes_; i++){
-            char name[50];
-            sprintf(name, "detecting^%d_(%d)", t, i);
-            detecting_[t].push_back(ctx_.bool_const(name));
+void Solver::set_options(const SolverOptions& options){
+    options_ = options;
+    width_built_ = -1;
+    cache_.reset();
+    if(options_.max_memory_mb_ > 0){
+        z3::set_param("memory_max_size", (int)options_.max_memory_mb_);
+    }
+}
+
+void Solver::set_timeout(unsigned ms){
+    params p(ctx_);
+    p.set("timeout", ms > 0 ? ms : 4294967295u); // z3's default, no timeout
+    if(options_.backend_ == SAT){
+        sat_solver_.set(p);
+    }else{
+        solver_.set(p);
+    }
+}
+
+void Solver::add(const expr& e){
+    no_of_assertions_++;
+    stats_.phases_[phase_].assertions_++;
+    if(options_.backend_ == SAT){
+        sat_solver_.add(e);
+    }else{
+        solver_.add(e);
+    }
+}
 
-            expr e = ite(detecting_[t][i], one, zero);
-            counter.push_back(e);
-        } 
+void Solver::push(){
+    if(options_.backend_ == SAT){
+        sat_solver_.push();
+    }else{
+        solver_.push();
+    }
+}
+
+void Solver::pop(){
+    if(options_.backend_ == SAT){
+        sat_solver_.pop();
+    }else{
+        solver_.pop();
+    }
+}
+
+check_result Solver::run_check(){
+    // z3 only sees an interrupt while it is checking, so one during model building is caught here
+    if(interrupted_){
+        return unknown;
+    }
+    check_result res;
+    if(fixed_.empty()){
+        res = options_.backend_ == SAT ? sat_solver_.check() : solver_.check();
+    }else{
+        res = options_.backend_ == SAT ? sat_solver_.check(fixed_) : solver_.check(fixed_);
+    }
+    if(res == sat){
+        model_ = options_.backend_ == SAT ? sat_solver_.get_model() : solver_.get_model();
+        decoded_ = false;
+    }
+    return res;
+}
+
+expr_vector Solver::hint_literals(){
+    expr_vector res(ctx_);
+    // constants are decided by the encoding already, a false one is a move that is not allowed
+    auto hint = [&](const expr& v){
+        if(!v.is_true() && !v.is_false()){
+            res.push_back(v);
+        }
+    };
+    vector<Type> module_type(no_of_nodes_, NONE);
+    for(auto& pair: arch_.modules_){
+        module_type[pair.second.id_] = pair.second.type_;
+    }
+
+    // a port on the right or bottom side stays on the border as the grid grows or shrinks
+    int w0 = hint_width_, h0 = hint_height_;
+    for(int p = 0; p < (w0 + h0) * 2; p++){
+        int l = hint_.ports_[p];
+        if(l < 0){
+            continue;
+        }
+        int x, y, side;
+        perimeter_cell(w0, h0, p, x, y, side);
+        if(side == 1){
+            x = width_cur_ - 1;
+        }else if(side == 2){
+            y = height_cur_ - 1;
+        }
+        if(!is_point_inbound(x, y)){
+            continue;
+        }
+        int q = perimeter_pos(x, y, side);
+        hint(module_type[l] == DISPENSER ? dispenser_(q, l) : sink_(q, l));
+    }
+    for(int y = 0; y < h0; y++){
+        for(int x = 0; x < w0; x++){
+            int l = hint_.detectors_[y*w0 + x];
+            if(l >= 0 && is_point_inbound(x, y)){
+                hint(detector_(x, y, l));
+            }
+        }
     }
+    for(int t = 1; t <= min(hint_time_, time_cur_); t++){
+        for(int y = 0; y < min(h0, height_cur_); y++){
+            for(int x = 0; x < min(w0, width_cur_); x++){
+                int i = hint_.cells_[(t*h0 + y)*w0 + x];
+                if(i >= 0){
+                    hint(c_(t, x, y, i));
+                }
+            }
+        }
+    }
+    return res;
+}
 
-    // add optimizing condition to solver to reduce total number of steps
-    no_of_actions_ = ctx_.int_const("no_of_actions");
-    solver_.add(no_of_actions_ == sum(counter));
-    optimize_handle_ = solver_.minimize(no_of_actions_);
+check_result Solver::run_hinted_check(){
+    expr_vector hints = hint_literals();
+    unsigned no_of_fixed = fixed_.size();
+    check_result res = unsat;
+    // every round drops at least one literal, past a few the hint is too far off to help
+    for(int round = 0; round < 8 && !hints.empty(); round++){
+        for(unsigned k = 0; k < hints.size(); k++){
+            fixed_.push_back(hints[k]);
+        }
+        res = run_check();
+        expr_vector core(ctx_);
+        if(res == unsat){
+            core = options_.backend_ == SAT ? sat_solver_.unsat_core() : solver_.unsat_core();
+        }
+        fixed_.resize(no_of_fixed);
+        if(res != unsat){
+            return res;
+        }
+        unordered_set<unsigned> in_core;
+        for(unsigned k = 0; k < core.size(); k++){
+            in_core.insert(core[k].id());
+        }
+        expr_vector kept(ctx_);
+        for(unsigned k = 0; k < hints.size(); k++){
+            if(!in_core.count(hints[k].id())){
+                kept.push_back(hints[k]);
+            }
+        }
+        if(kept.size() == hints.size()){
+            return unsat; // without any of the hint
+        }
+        hints = kept;
+    }
+    return run_check();
+}
 
-    // detector_(x,y,l)
-    detector_.resize(width);
-    for(int w = 0; w < width; w++){
-        detector_[w].resize(height);
-        for(int h = 0; h < height; h++){
-            for(int l = 0; l < no_of_nodes_; l++){ 
-                char name[50];
-                sprintf(name, "detector_(%d,%d,%d)", w, h, l);
-                detector_[w][h].push_back(ctx_.bool_const(name));
+expr Solver::at_most(const expr_vector& lits, int k){
+    // literals that are false by construction do not count
+    expr_vector vec(ctx_);
+    for(unsigned i = 0; i < lits.size(); i++){
+        if(!lits[i].is_false()){
+            vec.push_back(lits[i]);
+        }
+    }
+    int n = vec.size();
+    if(k >= n){
+        return ctx_.bool_val(true);
+    }
+    if(options_.backend_ != SAT){
+        return atmost(vec, k);
+    }
+    expr_vector clauses(ctx_);
+    if(k <= 0){
+        for(int i = 0; i < n; i++){
+            clauses.push_back(!vec[i]);
+        }
+        return mk_and(clauses);
+    }
+    if(k == 1 && n <= 5){
+        // pairwise is smaller than the counter for a handful of literals
+        for(int i = 0; i < n; i++){
+            for(int j = i + 1; j < n; j++){
+                clauses.push_back(!vec[i] || !vec[j]);
             }
         }
+        return mk_and(clauses);
     }
 
-    // dispenser_(p,l)
-    dispenser_.resize(perimeter_cur_);
-    for(int p = 0; p < perimeter_cur_; p++){
-        for(int l = 0; l < no_of_nodes_; l++){ // TODO: check
+    // sequential counter (Sinz 2005): s[i][j] means at least j+1 of vec[0..i] are true
+    vector<vector<expr>> s(n - 1);
+    for(int i = 0; i < n - 1; i++){
+        for(int j = 0; j < k; j++){
             char name[50];
-            sprintf(name, "dispenser_(%d,%d)", p, l);
-            dispenser_[p].push_back(ctx_.bool_const(name));
+            sprintf(name, "card!%d", no_of_aux_++);
+            s[i].push_back(ctx_.bool_const(name));
         }
     }
+    clauses.push_back(!vec[0] || s[0][0]);
+    for(int j = 1; j < k; j++){
+        clauses.push_back(!s[0][j]);
+    }
+    for(int i = 1; i < n - 1; i++){
+        clauses.push_back(!vec[i] || s[i][0]);
+        clauses.push_back(!s[i-1][0] || s[i][0]);
+        for(int j = 1; j < k; j++){
+            clauses.push_back(!vec[i] || !s[i-1][j-1] || s[i][j]);
+            clauses.push_back(!s[i-1][j] || s[i][j]);
+        }
+        clauses.push_back(!vec[i] || !s[i-1][k-1]);
+    }
+    clauses.push_back(!vec[n-1] || !s[n-2][k-1]);
+    return mk_and(clauses);
+}
 
-    // sink_(p)
-    sink_.resize(perimeter_cur_);
-    for(int p = 0; p < perimeter_cur_; p++){
-        for(int l = 0; l < no_of_nodes_; l++){
-            char name[50];
-            sprintf(name, "sink_(%d, %d)", p, l);
-            sink_[p].push_back(ctx_.bool_const(name));
+expr Solver::at_least(const expr_vector& lits, int k){
+    expr_vector vec(ctx_);
+    for(unsigned i = 0; i < lits.size(); i++){
+        if(!lits[i].is_false()){
+            vec.push_back(lits[i]);
         }
     }
+    int n = vec.size();
+    if(k <= 0){
+        return ctx_.bool_val(true);
+    }
+    if(k > n){
+        return ctx_.bool_val(false);
+    }
+    if(options_.backend_ != SAT){
+        return atleast(vec, k);
+    }
+    if(k == 1){
+        return mk_or(vec);
+    }
+    // at least k of vec <=> at most n-k of their negations
+    expr_vector neg(ctx_);
+    for(int i = 0; i < n; i++){
+        neg.push_back(!vec[i]);
+    }
+    return at_most(neg, n - k);
 }
 
-void Solver::add_consistency_constraints(){
+void Solver::add_consistency_constraints(int t_from, int t_to){
+    PhaseScope scope(*this, PHASE_CONSISTENCY);
     // a cell may not be occupied by more than one droplet or mixer i per time step
-    for(int t = 1; t <= time_cur_; t++){
+    for(int t = t_from; t <= t_to; t++){
         for(int x = 0; x < width_cur_; x++){
             for(int y = 0; y < height_cur_; y++){
                 expr_vector v_tmp(ctx_);
                 // mixer or detector node
                 for(auto module: arch_.nodes_){
                     if(module.type_ == MIXER){
-                        v_tmp.push_back(mixing_[t][x][y][module.id_]);
+                        v_tmp.push_back(mixing_(t, x, y, module.id_));
                     }else if(module.type_ == DETECTOR){
-                        v_tmp.push_back(detecting_[t][module.id_]);
+                        v_tmp.push_back(detecting_(t, module.id_));
                     }
                 }
 
                 // droplets
                 for(int i = 0; i < no_of_edges_; i++){
-                    v_tmp.push_back(c_[t][x][y][i]);
+                    v_tmp.push_back(c_(t, x, y, i));
                 }
-                solver_.add(atmost(v_tmp, 1));
+                add(at_most(v_tmp, 1));
             }
         }
     }
 
     // each droplet i may occur in at most one cell per time step
     for(int i = 0; i < no_of_edges_; i++){
-        for(int t = 1; t <= time_cur_; t++){
+        for(int t = t_from; t <= t_to; t++){
             expr_vector v_tmp(ctx_);
             for(int x = 0; x < width_cur_; x++){
                 for(int y = 0; y < height_cur_; y++){
-                    v_tmp.push_back(c_[t][x][y][i]);
+                    v_tmp.push_back(c_(t, x, y, i));
                 }
             }
-            solver_.add(atmost(v_tmp, 1));
+            add(at_most(v_tmp, 1));
         }
     }
     // solver_.add(mk_and(constraint_vec));
+}
 
+void Solver::add_placement_constraints(){
+    PhaseScope scope(*this, PHASE_PLACEMENT);
     // in each position p outside of the grid, there may be at most one dispenser (this applies for all types l) or sink
     for(int p = 0; p < perimeter_cur_; p++){
         expr_vector v_tmp(ctx_);
         //v_tmp.push_back(sink_[p]);
         for(auto module: arch_.modules_){
             if(module.second.type_ == DISPENSER){
-                v_tmp.push_back(dispenser_[p][module.second.id_]);
+                v_tmp.push_back(dispenser_(p, module.second.id_));
             }else if(module.second.type_ == SINK){
-                v_tmp.push_back(sink_[p][module.second.id_]); // changed
+                v_tmp.push_back(sink_(p, module.second.id_)); // changed
             }
         }
-        solver_.add(atmost(v_tmp, 1));
+        add(at_most(v_tmp, 1));
     }
 
     // each cell may be occupied by atmost one detector
@@ -492,18 +1586,15 @@ void Solver::add_consistency_constraints(){
             expr_vector v_tmp(ctx_);
             for(auto module: arch_.modules_){
                 if(module.second.type_ == DETECTOR){
-                    v_tmp.push_back(detector_[x][y][module.second.id_]);
+                    v_tmp.push_back(detector_(x, y, module.second.id_));
                 }
             }
             if(!v_tmp.empty()){
                 // constraint_vec.push_back(atmost(v_tmp, 1));
-                solver_.add(atmost(v_tmp, 1));
+                add(at_most(v_tmp, 1));
             }
         }
     }
-}
-
-void Solver::add_placement_constraints(){
 
     expr_vector constraint_vec(ctx_);
     
@@ -513,12 +1604,12 @@ void Solver::add_placement_constraints(){
             expr_vector v_tmp(ctx_);
             for(int x = 0; x < width_cur_; x++){
                 for(int y = 0; y < height_cur_; y++){
-                    v_tmp.push_back(detector_[x][y][module.second.id_]);
+                    v_tmp.push_back(detector_(x, y, module.second.id_));
                 }
             }
             // constraint_vec.push_back(EQ(v_tmp, 1)); 
-            solver_.add(atleast(v_tmp, 1));
-            solver_.add(atmost(v_tmp, 1));
+            add(at_least(v_tmp, 1));
+            add(at_most(v_tmp, 1));
         }
     }
     // solver_.add(mk_and(constraint_vec));
@@ -529,36 +1620,40 @@ void Solver::add_placement_constraints(){
         if(module.second.type_ == DISPENSER){
             expr_vector v_tmp(ctx_);
             for(int p = 0; p < perimeter_cur_; p++){
-                v_tmp.push_back(dispenser_[p][module.second.id_]);
+                v_tmp.push_back(dispenser_(p, module.second.id_));
             }
             // constraint_vec.push_back(EQ(v_tmp, module.desired_amount_));
-            solver_.add(atleast(v_tmp, module.second.desired_amount_));
-            solver_.add(atmost(v_tmp, module.second.desired_amount_));
+            add(at_least(v_tmp, module.second.desired_amount_));
+            add(at_most(v_tmp, module.second.desired_amount_));
         }else if(module.second.type_ == SINK){
             expr_vector v_tmp(ctx_);
             for(int p = 0; p < perimeter_cur_; p++){
-                v_tmp.push_back(sink_[p][module.second.id_]);
+                v_tmp.push_back(sink_(p, module.second.id_));
             }
             // constraint_vec.push_back(EQ(v_tmp, module.desired_amount_));
-            solver_.add(atleast(v_tmp, module.second.desired_amount_));
-            solver_.add(atmost(v_tmp, module.second.desired_amount_));
+            add(at_least(v_tmp, module.second.desired_amount_));
+            add(at_most(v_tmp, module.second.desired_amount_));
         }
     }
     // solver_.add(mk_and(constraint_vec));
 }
 
-void Solver::add_movement(){
+void Solver::add_movement(int t_from, int t_to){
+    PhaseScope scope(*this, PHASE_MOVEMENT);
     for(int i = 0; i < no_of_edges_; i++){
         for(int x = 0; x < width_cur_; x++){
             for(int y = 0; y < height_cur_; y++){
-                for(int t = 1; t <= time_cur_; t++){
+                for(int t = t_from; t <= t_to; t++){
+                    if(c_(t, x, y, i).is_false()){
+                        continue;
+                    }
                     expr_vector vec(ctx_);
                     // move
                     for(int k = 0; k < 5; k++){
                         int xx = x + dx[k];
                         int yy = y + dy[k];
                         if(is_point_inbound(xx, yy)){
-                            vec.push_back(c_[t-1][xx][yy][i]);
+                            vec.push_back(c_(t-1, xx, yy, i));
                         }
                     }
 
@@ -568,16 +1663,16 @@ void Solver::add_movement(){
                         string label = arch_.nodes_[id].label_;
                         int dispenser_id = arch_.modules_[label].id_;
                         if(x == 0){ // (x,y) on left edge
-                            vec.push_back(dispenser_[perimeter_cur_ - 1 - y][dispenser_id]);
+                            vec.push_back(dispenser_(perimeter_pos(x, y, 3), dispenser_id));
                         }
                         if(x == width_cur_-1){ // right edge
-                            vec.push_back(dispenser_[width_cur_ - 1 + y][dispenser_id]);
+                            vec.push_back(dispenser_(perimeter_pos(x, y, 1), dispenser_id));
                         }
                         if(y == 0){ // top edge
-                            vec.push_back(dispenser_[x][dispenser_id]);
+                            vec.push_back(dispenser_(perimeter_pos(x, y, 0), dispenser_id));
                         }
                         if(y == height_cur_-1){ // bottom edge
-                            vec.push_back(dispenser_[2*width_cur_ + height_cur_ - 1 - x][dispenser_id]);
+                            vec.push_back(dispenser_(perimeter_pos(x, y, 2), dispenser_id));
                         }
                     }
 
@@ -591,12 +1686,11 @@ void Solver::add_movement(){
                             for(int dir = 0; dir < mixer_w*mixer_h; dir++){
                                 int x0 = x - dir % mixer_w;
                                 int y0 = y - dir / mixer_w;
-                                if(is_point_inbound(x0, y0) && is_point_inbound(x+mixer_w-1, y+mixer_h-1)){
+                                if(is_point_inbound(x0, y0) && is_point_inbound(x0+mixer_w-1, y0+mixer_h-1)){
                                     expr_vector mix_vec(ctx_);
                                     for(int m = 0; m < no_of_edges_; m++){
                                         if(arch_.edges_[m].second == id){
                                             expr_vector appear_before_mix(ctx_);
-                                            expr_vector diappear_on_mix(ctx_);
                                             for(int ddx = -1; ddx <= mixer_w; ddx++){
                                                  for(int ddy = -1; ddy <= mixer_h; ddy++){
                                                      if((ddx==-1&&ddy==-1) || (ddx==-1&&ddy==mixer_h) || (ddx==mixer_w&&ddy==-1) || (ddx==mixer_w&&ddy==mixer_h)){
@@ -605,17 +1699,12 @@ void Solver::add_movement(){
                                                      int x_new = x0 + ddx;
                                                      int y_new = y0 + ddy;
                                                      if(is_point_inbound(x_new, y_new)){
-                                                         appear_before_mix.push_back(c_[t-d-1][x_new][y_new][m]);
+                                                         appear_before_mix.push_back(c_(t-d-1, x_new, y_new, m));
                                                      }
                                                  }
                                              }
-                                            for(int xx = 0; xx < width_cur_; xx++){
-                                                for(int yy = 0; yy < height_cur_; yy++){
-                                                    diappear_on_mix.push_back(c_[t-d][xx][yy][m]);
-                                                }
-                                            }
                                             mix_vec.push_back(mk_or(appear_before_mix));
-                                            mix_vec.push_back(!mk_or(diappear_on_mix));
+                                            mix_vec.push_back(!present_(t-d, m)); // disappear on mix
                                         }
                                     }
 
@@ -623,7 +1712,7 @@ void Solver::add_movement(){
                                     for(int xx = 0; xx < mixer_w; xx++){
                                         for(int yy = 0; yy < mixer_h; yy++){
                                             for(int t_lag = t-d; t_lag < t; t_lag++){
-                                                mixing_vec.push_back(mixing_[t_lag][xx+x0][yy+y0][id]);
+                                                mixing_vec.push_back(mixing_(t_lag, xx+x0, yy+y0, id));
                                             }
                                         }
                                     }
@@ -635,16 +1724,10 @@ void Solver::add_movement(){
                                             expr_vector appear_at_t(ctx_);
                                             for(int x_new = x0; x_new < x0+mixer_w; x_new++){
                                                 for(int y_new = y0; y_new < y0+mixer_h; y_new++){
-                                                    appear_at_t.push_back(c_[t][x_new][y_new][m]);
+                                                    appear_at_t.push_back(c_(t, x_new, y_new, m));
                                                 }
                                             }
-                                            expr_vector no_before_t(ctx_);
-                                            for(int x_new = 0; x_new < width_cur_; x_new++){
-                                                for(int y_new = 0; y_new < height_cur_; y_new++){
-                                                    no_before_t.push_back(c_[t-1][x_new][y_new][m]);
-                                                }
-                                            }
-                                            d_vec.push_back(mk_or(appear_at_t) && !mk_or(no_before_t));
+                                            d_vec.push_back(mk_or(appear_at_t) && !present_(t-1, m)); // not there before t
                                         }
                                     }
                                     mix_vec.push_back(mk_and(d_vec));
@@ -664,11 +1747,11 @@ void Solver::add_movement(){
                                 if(arch_.edges_[m].second == id){
                                     expr_vector detec_vec(ctx_);
 
-                                    detec_vec.push_back(detector_[x][y][detector_id]);
-                                    detec_vec.push_back(c_[t-d-1][x][y][m]);
-                                    detec_vec.push_back(!c_[t-d][x][y][m]);
+                                    detec_vec.push_back(detector_(x, y, detector_id));
+                                    detec_vec.push_back(c_(t-d-1, x, y, m));
+                                    detec_vec.push_back(!c_(t-d, x, y, m));
                                     for(int t_lag = t-d; t_lag < t; t_lag++){
-                                        detec_vec.push_back(detecting_[t_lag][id]);
+                                        detec_vec.push_back(detecting_(t_lag, id));
                                     }
                                     vec.push_back(mk_and(detec_vec));
                                     break;
@@ -678,10 +1761,10 @@ void Solver::add_movement(){
                     }
 
                     if(vec.size() > 0){
-                        solver_.add(implies(c_[t][x][y][i], atmost(vec, 1)));
-                        solver_.add(implies(c_[t][x][y][i], atleast(vec, 1)));
+                        add(implies(c_(t, x, y, i), at_most(vec, 1)));
+                        add(implies(c_(t, x, y, i), at_least(vec, 1)));
                     }else{
-                        solver_.add(implies(c_[t][x][y][i], ctx_.bool_val(false)));
+                        add(implies(c_(t, x, y, i), ctx_.bool_val(false)));
                     }
 
                 }
@@ -698,48 +1781,43 @@ void Solver::add_movement(){
                 if(arch_.edges_[i].second == m){
                     for(int x = 0; x < width_cur_; x++){
                         for(int y = 0; y < height_cur_; y++){
-                            for(int t = 2; t <= time_cur_; t++){
+                            for(int t = max(2, t_from); t <= t_to; t++){
+                                if(c_(t-1, x, y, i).is_false()){
+                                    continue;
+                                }
                                 expr_vector vec(ctx_);
                                 // disappear at t;;
                                 for(int k = 0; k < 5; k++){
                                     int xx = x + dx[k];
                                     int yy = y + dy[k];
                                     if(is_point_inbound(xx, yy)){
-                                        vec.push_back(c_[t][xx][yy][i]);
+                                        vec.push_back(c_(t, xx, yy, i));
                                     }
                                 }
                                 expr d_tmp = not(mk_or(vec));
-                                expr disappear = c_[t-1][x][y][i] && d_tmp;
+                                expr disappear = c_(t-1, x, y, i) && d_tmp;
 
                                 expr_vector b_vec(ctx_); // there is a sink at reachable position
                                 if(x == 0){ // (x,y) on left edge
-                                    b_vec.push_back(sink_[perimeter_cur_ - 1 - y][id_sink]);
+                                    b_vec.push_back(sink_(perimeter_pos(x, y, 3), id_sink));
                                 }
                                 if(x == width_cur_-1){ // right edge
-                                    b_vec.push_back(sink_[width_cur_ - 1 + y][id_sink]);
+                                    b_vec.push_back(sink_(perimeter_pos(x, y, 1), id_sink));
                                 }
                                 if(y == 0){ // top edge
-                                    b_vec.push_back(sink_[x][id_sink]);
+                                    b_vec.push_back(sink_(perimeter_pos(x, y, 0), id_sink));
                                 }
                                 if(y == height_cur_-1){ // bottom edge
-                                    b_vec.push_back(sink_[2*width_cur_ + height_cur_ - 1 - x][id_sink]);
+                                    b_vec.push_back(sink_(perimeter_pos(x, y, 2), id_sink));
                                 }
                                 if(b_vec.size() > 0){
-                                    solver_.add(implies(disappear, mk_or(b_vec)));
+                                    add(implies(disappear, mk_or(b_vec)));
                                 }else{
-                                    solver_.add(implies(disappear, ctx_.bool_val(false)));
+                                    add(implies(disappear, ctx_.bool_val(false)));
                                 }
                             }
                         }
                     }
-
-                    expr_vector disappear_last(ctx_);
-                    for(int x = 0; x < width_cur_; x++){
-                        for(int y = 0; y < height_cur_; y++){
-                            disappear_last.push_back(c_[time_cur_][x][y][i]);
-                        }
-                    }
-                    solver_.add(!mk_or(disappear_last));
                 }
             }
         }
@@ -752,17 +1830,17 @@ void Solver::add_objectives(){
     // all droplets have to be present for at least one step
     expr_vector all_droplets_appear_vec(ctx_);
     for(int i = 0; i < no_of_edges_; i++){
+        // a scheduled droplet only once its window is over
+        if(!arch_.deadline_.empty() && arch_.deadline_[i] > time_cur_){
+            continue;
+        }
         expr_vector v_tmp(ctx_);
         for(int t = 1; t <= time_cur_; t++){
-            for(int x = 0; x < width_cur_; x++){
-                for(int y = 0; y < height_cur_; y++){
-                        v_tmp.push_back(c_[t][x][y][i]);
-                }
-            }
+            v_tmp.push_back(present_(t, i));
         }
         all_droplets_appear_vec.push_back(mk_or(v_tmp));
     }
-    solver_.add(mk_and(all_droplets_appear_vec));
+    add(mk_and(all_droplets_appear_vec));
 
   /*   expr_vector all_droplets_disappear_vec(ctx_);
     for(int i = 0; i < no_of_edges_; i++){
@@ -770,7 +1848,7 @@ void Solver::add_objectives(){
         if(arch_.nodes_[id_module].type_ == SINK){
             for(int x = 0; x < width_cur_; x++){
                 for(int y = 0; y < height_cur_; y++){
-                    all_droplets_disappear_vec.push_back(c_[time_cur_][x][y][i]);
+                    all_droplets_disappear_vec.push_back(c_(time_cur_, x, y, i));
                 }
             }
 
@@ -784,7 +1862,7 @@ void Solver::add_objectives(){
         if(module.type_ == DETECTOR){
             expr_vector v_tmp(ctx_);
             for(int t = 1; t <= time_cur_; t++){
-                v_tmp.push_back(detecting_[t][module.id_]);
+                v_tmp.push_back(detecting_(t, module.id_));
             }
             detection_triggered_vec.push_back(EQ(v_tmp, module.time_));
         }
@@ -792,12 +1870,47 @@ void Solver::add_objectives(){
     solver_.add(mk_and(detection_triggered_vec)); */
 }
 
-void Solver::add_fluidic_constraints(){
+int Solver::earliest(int i, int x, int y){
+    int t = arch_.earliest_[i];
+    if(arch_.nodes_[arch_.edges_[i].first].type_ == DISPENSER){
+        t = max(t, 1 + border_distance(x, y)); // walked in from the border
+    }
+    return t;
+}
+
+int Solver::latest(int i, int x, int y){
+    int t = arch_.deadline_.empty() ? time_cur_ - arch_.slack_[i] : arch_.deadline_[i];
+    if(arch_.nodes_[arch_.edges_[i].second].type_ == SINK){
+        t -= border_distance(x, y); // still has to walk out to the border
+    }
+    return t;
+}
+
+void Solver::add_time_windows(){
+    // this includes droplets to a sink having left the grid at the last step
     for(int i = 0; i < no_of_edges_; i++){
-        for(int t = 1; t < time_cur_; t++){
+        for(int x = 0; x < width_cur_; x++){
+            for(int y = 0; y < height_cur_; y++){
+                for(int t = max(1, latest(i, x, y) + 1); t <= time_cur_; t++){
+                    if(!c_(t, x, y, i).is_false()){
+                        add(!c_(t, x, y, i));
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Solver::add_fluidic_constraints(int t_from, int t_to){
+    PhaseScope scope(*this, PHASE_FLUIDIC);
+    // a constraint at t belongs to the latest step it looks at (t+1 or t+2)
+    for(int i = 0; i < no_of_edges_; i++){
+        for(int t = max(1, t_from-2); t < t_to; t++){
             for(int x = 0; x < width_cur_; x++){
                 for(int y = 0; y < height_cur_; y++){
-                    expr a = c_[t][x][y][i];
+                    if(c_(t, x, y, i).is_false()){
+                        continue;
+                    }
 
                     for(int x_new = x-1; x_new <= x+1; x_new++){
                         for(int y_new = y-1; y_new <= y+1; y_new++){
@@ -806,30 +1919,18 @@ void Solver::add_fluidic_constraints(){
                                     if(j == i){
                                         continue;
                                     }
-                                    expr a = c_[t][x][y][i] && c_[t][x_new][y_new][j];
-                                    // (1): for any droplet^t_i, if there is another droplet nearb at time t 
-                                    // they should be mixed together at time t+1
-                                    expr_vector c1_vec(ctx_);
-                                    for(int xx = 0; xx < width_cur_; xx++){
-                                        for(int yy = 0; yy < height_cur_; yy++){
-                                            c1_vec.push_back(c_[t+1][xx][yy][i]);
-                                            c1_vec.push_back(c_[t+1][xx][yy][j]);
-                                        }
+                                    if(t+1 >= t_from && !c_(t, x_new, y_new, j).is_false()){
+                                        expr a = c_(t, x, y, i) && c_(t, x_new, y_new, j);
+                                        // (1): for any droplet^t_i, if there is another droplet nearb at time t 
+                                        // they should be mixed together at time t+1
+                                        add(implies(a, !present_(t+1, i) && !present_(t+1, j)));
                                     }
-                                    solver_.add(implies(a, !mk_or(c1_vec)));
                                     
-                                    if(t < time_cur_-1){
-                                        expr b = c_[t][x][y][i] && c_[t+1][x_new][y_new][j];
+                                    if(t+2 >= t_from && t+2 <= t_to && !c_(t+1, x_new, y_new, j).is_false()){
+                                        expr b = c_(t, x, y, i) && c_(t+1, x_new, y_new, j);
                                         // (2): for any droplet^t_i, if there is another droplet nearb at time t+1
                                         // droplet^(t+1)_i mixed with droplet^(t+2)_j
-                                        expr_vector c2_vec(ctx_);
-                                        for(int xx = 0; xx < width_cur_; xx++){
-                                            for(int yy = 0; yy < height_cur_; yy++){
-                                                c2_vec.push_back(c_[t+1][xx][yy][i]);
-                                                c2_vec.push_back(c_[t+2][xx][yy][j]);
-                                            }
-                                        }
-                                        solver_.add(implies(b, !mk_or(c2_vec)));
+                                        add(implies(b, !present_(t+1, i) && !present_(t+2, j)));
                                     }
                                 }
                             }
@@ -841,10 +1942,138 @@ void Solver::add_fluidic_constraints(){
     }
 }
 
-void Solver::add_constraints(){
-    add_consistency_constraints();
-    add_placement_constraints();
-    add_movement();
-    add_objectives();
-    add_fluidic_constraints();
+void Solver::add_constraints(int t_from, int t_to){
+    add_consistency_constraints(t_from, t_to);
+    add_movement(t_from, t_to);
+    add_fluidic_constraints(t_from, t_to);
+    if(options_.symmetry_breaking_){
+        add_droplet_order(t_from, t_to);
+    }
+}
+
+void Solver::perimeter_cell(int w, int h, int p, int& x, int& y, int& side){
+    if(p < w){
+        x = p; y = 0; side = 0;
+    }else if(p < w + h){
+        x = w - 1; y = p - w; side = 1;
+    }else if(p < 2*w + h){
+        x = 2*w + h - 1 - p; y = h - 1; side = 2;
+    }else{
+        x = 0; y = 2*w + 2*h - 1 - p; side = 3;
+    }
+}
+
+int Solver::perimeter_pos(int w, int h, int x, int y, int side){
+    switch(side){
+        case 0: return x;
+        case 1: return w + y;
+        case 2: return 2*w + h - 1 - x;
+        default: return 2*w + 2*h - 1 - y;
+    }
+}
+
+void Solver::add_symmetry_breaking(){
+    PhaseScope scope(*this, PHASE_SYMMETRY);
+    // mirroring the grid (and transposing a square one when every mixer is square too)
+    // maps solutions to solutions, so only the copy whose placements are lexicographically
+    // smallest needs to be found
+    bool square = width_cur_ == height_cur_;
+    for(auto module: arch_.modules_){
+        if(module.second.type_ == MIXER && module.second.w != module.second.h){
+            square = false;
+        }
+    }
+
+    // placement variables and their images under one symmetry
+    expr_vector placement(ctx_);
+    for(auto module: arch_.modules_){
+        if(module.second.type_ == DISPENSER || module.second.type_ == SINK){
+            auto& vars = module.second.type_ == DISPENSER ? dispenser_ : sink_;
+            for(int p = 0; p < perimeter_cur_; p++){
+                placement.push_back(vars(p, module.second.id_));
+            }
+        }else if(module.second.type_ == DETECTOR){
+            for(int x = 0; x < width_cur_; x++){
+                for(int y = 0; y < height_cur_; y++){
+                    placement.push_back(detector_(x, y, module.second.id_));
+                }
+            }
+        }
+    }
+
+    const int mirror_side[3][4] = {
+        {0, 3, 2, 1}, // flip x: left <-> right
+        {2, 1, 0, 3}, // flip y: top <-> bottom
+        {3, 2, 1, 0}  // transpose: top <-> left, right <-> bottom
+    };
+    for(int g = 1; g < (square ? 8 : 4); g++){
+        bool flip_x = g & 1, flip_y = g & 2, transpose = g & 4;
+        auto image = [&](int& x, int& y, int& side){
+            if(flip_x){ x = width_cur_ - 1 - x; side = mirror_side[0][side]; }
+            if(flip_y){ y = height_cur_ - 1 - y; side = mirror_side[1][side]; }
+            if(transpose){ swap(x, y); side = mirror_side[2][side]; }
+        };
+
+        expr_vector mirrored(ctx_);
+        for(auto module: arch_.modules_){
+            if(module.second.type_ == DISPENSER || module.second.type_ == SINK){
+                auto& vars = module.second.type_ == DISPENSER ? dispenser_ : sink_;
+                for(int p = 0; p < perimeter_cur_; p++){
+                    int x, y, side;
+                    perimeter_cell(p, x, y, side);
+                    image(x, y, side);
+                    mirrored.push_back(vars(perimeter_pos(x, y, side), module.second.id_));
+                }
+            }else if(module.second.type_ == DETECTOR){
+                for(int x = 0; x < width_cur_; x++){
+                    for(int y = 0; y < height_cur_; y++){
+                        int xx = x, yy = y, side = 0;
+                        image(xx, yy, side);
+                        mirrored.push_back(detector_(xx, yy, module.second.id_));
+                    }
+                }
+            }
+        }
+
+        // placement <=_lex mirrored, same_prefix means everything before k is equal
+        expr same_prefix = ctx_.bool_val(true);
+        for(unsigned k = 0; k < placement.size(); k++){
+            expr a = placement[k], b = mirrored[k];
+            if(eq(a, b)){
+                continue;
+            }
+            add(implies(same_prefix && a, b));
+            char name[50];
+            sprintf(name, "sym!%d", no_of_aux_++);
+            expr next = ctx_.bool_const(name);
+            add(implies(same_prefix && a && b, next));
+            add(implies(same_prefix && !a && !b, next));
+            same_prefix = next;
+        }
+    }
+}
+
+void Solver::add_droplet_order(int t_from, int t_to){
+    PhaseScope scope(*this, PHASE_SYMMETRY);
+    // droplets from dispensers of the same type into the same mixer or sink can trade places,
+    // the one with the smaller id is kept the first to appear
+    for(int i = 0; i < no_of_edges_; i++){
+        for(int j = i + 1; j < no_of_edges_; j++){
+            const Module& src_i = arch_.nodes_[arch_.edges_[i].first];
+            const Module& src_j = arch_.nodes_[arch_.edges_[j].first];
+            int dst = arch_.edges_[i].second;
+            if(src_i.type_ != DISPENSER || src_j.type_ != DISPENSER || src_i.label_ != src_j.label_
+                || dst != arch_.edges_[j].second || arch_.nodes_[dst].type_ == DETECTOR){
+                continue;
+            }
+            for(int t = t_from; t <= t_to; t++){
+                expr_vector appeared(ctx_);
+                for(int t_prev = 1; t_prev <= t; t_prev++){
+                    appeared.push_back(present_(t_prev, i));
+                }
+                add(implies(present_(t, j), mk_or(appeared)));
+            }
+            break; // the next pair of the chain orders j
+        }
+    }
 }
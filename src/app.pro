@@ -30,16 +30,22 @@ SOURCES += \
         renderarea.cpp \
         main.cpp \
         mainwindow.cpp \
+        solvethread.cpp \
         Architecture.cc \
-        Solver.cc
+        Solver.cc \
+        SolutionCache.cc \
+        SolutionTrace.cc
 
 HEADERS += \
         include/mainwindow.h \
         include/Architecture.h \
         include/Module.h \
         include/Solver.h \
+        include/SolutionCache.h \
+        include/SolutionTrace.h \
         include/OnePassSynth.h \
-        include/renderarea.h
+        include/renderarea.h \
+        include/solvethread.h
 
 FORMS += \
         mainwindow.ui
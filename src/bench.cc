@@ -0,0 +1,282 @@
+#include "Architecture.h"
+#include "Solver.h"
+#include "DriverUtil.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// benchmark driver: every assay (and scaled copies of it) is solved in a fresh process,
+// one JSON object per line on stdout with the time of each phase, the encoding size and peak memory
+
+struct BenchOptions {
+    int width_;   // <= 0: the SIZE of the assay, clamped to [3, 8]
+    int height_;
+    int time_;    // <= 0: the TIME of the assay, at most 40
+    vector<int> scales_;
+    int timeout_; // seconds per case
+    SolverOptions solver_;
+
+    BenchOptions(): width_(0), height_(0), time_(0), scales_(1, 1), timeout_(300) {}
+};
+
+static void usage(const char* prog){
+    cerr << "Usage: " << prog << " [options] <assay file or directory>..." << endl
+         << "  Each case is the smallest sat horizon on one grid, as synth -g finds it." << endl
+         << "  -w <n>              width (default: SIZE of the assay, clamped to 3..8)" << endl
+         << "  -h <n>              height" << endl
+         << "  -t <n>              largest horizon (default: TIME of the assay, at most 40)" << endl
+         << "  --scale <k,...>     also run k disjoint copies of every assay on a grid ceil(sqrt(k)) times as wide and high (default: 1)" << endl
+         << "  --timeout <s>       seconds per case (default: 300)" << endl;
+    solver_options_usage(cerr);
+}
+
+static bool parse_args(int argc, char* argv[], BenchOptions& opts, vector<string>& inputs){
+    for(int i = 1; i < argc; i++){
+        int solver_option = parse_solver_option(argc, argv, i, opts.solver_);
+        if(solver_option != 0){
+            if(solver_option < 0){
+                return false;
+            }
+            continue;
+        }
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if(arg == "--scale" && has_value){
+            opts.scales_.clear();
+            stringstream list(argv[++i]);
+            string item;
+            int k;
+            while(getline(list, item, ',')){
+                if(!parse_int(item.c_str(), k) || k < 1){
+                    cerr << "Expected scales like 1,2,4 after --scale" << endl;
+                    return false;
+                }
+                opts.scales_.push_back(k);
+            }
+        }else if(arg == "-w" || arg == "-h" || arg == "-t" || arg == "--timeout"){
+            int value;
+            if(!has_value || !parse_int(argv[++i], value)){
+                cerr << "Expected a number after " << arg << endl;
+                return false;
+            }
+            if(arg == "-w") opts.width_ = value;
+            else if(arg == "-h") opts.height_ = value;
+            else if(arg == "-t") opts.time_ = value;
+            else opts.timeout_ = max(1, value);
+        }else if(arg.size() > 1 && arg[0] == '-'){
+            cerr << "Unknown option: " << arg << endl;
+            return false;
+        }else{
+            inputs.push_back(arg);
+        }
+    }
+    return !inputs.empty();
+}
+
+static string read_file(const string& filename){
+    ifstream in(filename, ios::binary);
+    stringstream buf;
+    buf << in.rdbuf();
+    return buf.str();
+}
+
+// k disjoint copies of the assay, sharing its modules so that only droplets and operations multiply
+static string scaled_assay(const Architecture& arch, int k){
+    ostringstream out;
+    int n = arch.nodes_.size();
+    out << "DAGNAME (" << arch.label_ << " x" << k << ")\n";
+    for(int c = 0; c < k; c++){
+        for(auto& m: arch.nodes_){
+            out << "NODE (" << c*n + m.id_ + 1 << ", ";
+            switch(m.type_){
+                case MIXER: out << "MIX, " << m.drops_ << ", " << m.time_; break;
+                case DETECTOR: out << "DETECT, " << m.drops_ << ", " << m.time_; break;
+                case DISPENSER: out << "DISPENSE, " << m.fluid_type_ << ", " << m.volume_; break;
+                default: out << "OUTPUT, " << m.sink_name_; break;
+            }
+            out << ", " << m.label_ << ")\n";
+        }
+        for(auto& e: arch.edges_){
+            out << "EDGE (" << c*n + e.first + 1 << ", " << c*n + e.second + 1 << ")\n";
+        }
+    }
+    for(auto& pair: arch.modules_){
+        const Module& m = pair.second;
+        if(m.type_ == MIXER){
+            out << "MOD (" << m.label_ << ", " << m.w << ", " << m.h << ")\n";
+        }else if(m.type_ == SINK || m.type_ == DISPENSER){
+            out << "MOD (" << m.label_ << ", " << m.desired_amount_ << ")\n";
+        }
+    }
+    out << "TIME (" << arch.time_limit_ << ")\n";
+    out << "SIZE (" << arch.width_limit_ << ", " << arch.height_limit_ << ")\n";
+    return out.str();
+}
+
+struct BenchCase {
+    string assay_;
+    int scale_;
+    string text_;
+    int width_, height_, time_;
+};
+
+// runs in the worker process, writes the result line to out_fd
+static void run_case(const BenchCase& bc, const BenchOptions& opts, int out_fd){
+    ostringstream json;
+    json << "{\"assay\": " << json_string(bc.assay_) << ", \"scale\": " << bc.scale_
+         << ", \"width\": " << bc.width_ << ", \"height\": " << bc.height_ << ", \"time_limit\": " << bc.time_;
+
+    Architecture arch;
+    double parse_ms = 0;
+    bool parsed;
+    {
+        PhaseTimer timer(parse_ms);
+        parsed = arch.build_from_text(bc.assay_, bc.text_);
+    }
+    json << ", \"parse_ms\": " << parse_ms;
+
+    if(!parsed){
+        json << ", \"result\": \"error\", \"error\": " << json_string(arch.errors_.front());
+    }else{
+        z3::context ctx;
+        Solver solver(arch, ctx);
+        solver.set_options(opts.solver_);
+        int candidates = 0, max_vars = 0, max_aux = 0, max_assertions = 0;
+        solver.set_progress_callback([&](int, int, int, long long, bool, const string&){
+            candidates++;
+            max_vars = max(max_vars, solver.get_no_of_vars());
+            max_aux = max(max_aux, solver.get_no_of_aux());
+            max_assertions = max(max_assertions, solver.get_no_of_assertions());
+        });
+
+        double total_ms = 0;
+        bool is_sat;
+        {
+            PhaseTimer timer(total_ms);
+            is_sat = solver.solve_grid(bc.width_, bc.height_, bc.time_);
+            if(is_sat){
+                solver.get_grid(); // model extraction, the decode phase
+            }
+        }
+
+        json << ", \"result\": \"" << (is_sat ? "sat" : "unsat") << "\"";
+        if(is_sat){
+            json << ", \"time\": " << solver.get_time();
+        }
+        json << ", \"candidates\": " << candidates << ", \"total_ms\": " << total_ms << ", \"phases_ms\": {";
+        for(int p = 0; p < NO_OF_PHASES; p++){
+            json << (p ? ", " : "") << "\"" << phase_name((Phase)p) << "\": " << solver.get_stats().phases_[p].ms_;
+        }
+        // the largest encoding of all candidates
+        json << "}, \"vars\": " << max_vars << ", \"aux_vars\": " << max_aux << ", \"assertions\": " << max_assertions;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    json << ", \"peak_rss_kb\": " << usage.ru_maxrss << "}\n";
+    string line = json.str();
+    if(write(out_fd, line.c_str(), line.size()) < 0){
+        _exit(2);
+    }
+}
+
+// the result line of one case, or what is known of it when the worker did not finish
+static string bench(const BenchCase& bc, const BenchOptions& opts){
+    int fds[2];
+    if(pipe(fds) != 0){
+        return "";
+    }
+    cout.flush();
+    pid_t pid = fork();
+    if(pid == 0){
+        close(fds[0]);
+        // the solver log is not part of the results
+        if(freopen("/dev/null", "w", stdout) == nullptr){
+            _exit(2);
+        }
+        alarm(opts.timeout_);
+        run_case(bc, opts, fds[1]);
+        _exit(0);
+    }
+    close(fds[1]);
+    string line;
+    char buf[4096];
+    ssize_t n;
+    while(pid > 0 && (n = read(fds[0], buf, sizeof(buf))) > 0){
+        line.append(buf, n);
+    }
+    close(fds[0]);
+
+    int status = 0;
+    if(pid < 0 || waitpid(pid, &status, 0) < 0){
+        status = -1;
+    }
+    if(!line.empty()){
+        return line;
+    }
+    ostringstream json;
+    json << "{\"assay\": " << json_string(bc.assay_) << ", \"scale\": " << bc.scale_
+         << ", \"width\": " << bc.width_ << ", \"height\": " << bc.height_ << ", \"time_limit\": " << bc.time_;
+    if(status != -1 && WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM){
+        json << ", \"result\": \"timeout\", \"timeout_s\": " << opts.timeout_ << "}\n";
+    }else{
+        json << ", \"result\": \"failed\"";
+        if(status != -1 && WIFSIGNALED(status)){
+            json << ", \"signal\": " << WTERMSIG(status);
+        }
+        json << "}\n";
+    }
+    return json.str();
+}
+
+int main(int argc, char* argv[]){
+    BenchOptions opts;
+    vector<string> inputs;
+    if(!parse_args(argc, argv, opts, inputs)){
+        usage(argv[0]);
+        return 2;
+    }
+    vector<string> files;
+    if(!expand_inputs(inputs, files)){
+        return 2;
+    }
+
+    for(auto& file: files){
+        // limits and copies come from the parsed assay, the worker parses its text again to time it
+        Architecture arch;
+        string text = read_file(file);
+        if(!arch.build_from_text(file, text)){
+            cout << "{\"assay\": " << json_string(file) << ", \"result\": \"error\", \"error\": " << json_string(arch.errors_.front()) << "}" << endl;
+            continue;
+        }
+        for(int k: opts.scales_){
+            BenchCase bc;
+            bc.assay_ = file;
+            bc.scale_ = k;
+            bc.text_ = k == 1 ? text : scaled_assay(arch, k);
+            int grow = (int)ceil(sqrt((double)k));
+            bc.width_ = (opts.width_ > 0 ? opts.width_ : min(max(arch.width_limit_, 3), 8)) * grow;
+            bc.height_ = (opts.height_ > 0 ? opts.height_ : min(max(arch.height_limit_, 3), 8)) * grow;
+            bc.time_ = opts.time_ > 0 ? opts.time_ : min(arch.time_limit_, 40);
+            cerr << file << " x" << k << " (w=" << bc.width_ << ", h=" << bc.height_ << ", t<=" << bc.time_ << ")" << endl;
+            cout << bench(bc, opts) << flush;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,233 @@
+#include "OnePassSynth.h"
+#include "DriverUtil.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <future>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// headless driver: synthesizes every assay given on the command line, one worker process each
+
+struct CliOptions {
+    int width_;   // <= 0 keeps the limit from the input file
+    int height_;
+    int time_;
+    bool grid_;   // only the width x height grid, with the smallest time
+    bool flow_diagram_;
+    bool stats_;  // <out>/<assay>.stats.json
+    int jobs_;    // assays solved at the same time
+    int threads_; // portfolio threads per assay
+    string out_dir_;
+    SolverOptions solver_;
+
+    CliOptions(): width_(0), height_(0), time_(0), grid_(false), flow_diagram_(false), stats_(false), jobs_(1), threads_(1), out_dir_(".") {}
+};
+
+static void usage(const char* prog){
+    cerr << "Usage: " << prog << " [options] <assay file or directory>..." << endl
+         << "  -w <n>              width limit (default: from the input file)" << endl
+         << "  -h <n>              height limit" << endl
+         << "  -t <n>              time limit" << endl
+         << "  -g                  only solve the w x h grid, with the smallest time (within -t with --decompose)" << endl
+         << "  -j <n>              assays solved concurrently (default: 1)" << endl
+         << "  -p <n>              portfolio threads per assay (default: 1)" << endl
+         << "  -o <dir>            where <assay>.sol, <assay>.trace and <assay>.log are written (default: .)" << endl;
+    solver_options_usage(cerr);
+    cerr << "  --cache <dir>       reuse the solutions and unsat verdicts of earlier runs kept in dir" << endl
+         << "  --flow-diagram      also write <assay>.dot and render <assay>.png with graphviz" << endl
+         << "  --stats             also write <assay>.stats.json: time per phase, every candidate and its z3 statistics" << endl;
+}
+
+static bool parse_args(int argc, char* argv[], CliOptions& opts, vector<string>& inputs){
+    for(int i = 1; i < argc; i++){
+        int solver_option = parse_solver_option(argc, argv, i, opts.solver_);
+        if(solver_option != 0){
+            if(solver_option < 0){
+                return false;
+            }
+            continue;
+        }
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if(arg == "-g"){
+            opts.grid_ = true;
+        }else if(arg == "--stats"){
+            opts.stats_ = true;
+        }else if(arg == "--flow-diagram"){
+            opts.flow_diagram_ = true;
+        }else if(arg == "--cache" && has_value){
+            opts.solver_.cache_dir_ = argv[++i];
+        }else if(arg == "-o" && has_value){
+            opts.out_dir_ = argv[++i];
+        }else if(arg == "-w" || arg == "-h" || arg == "-t" || arg == "-j" || arg == "-p"){
+            int value;
+            if(!has_value || !parse_int(argv[++i], value)){
+                cerr << "Expected a number after " << arg << endl;
+                return false;
+            }
+            if(arg == "-w") opts.width_ = value;
+            else if(arg == "-h") opts.height_ = value;
+            else if(arg == "-t") opts.time_ = value;
+            else if(arg == "-j") opts.jobs_ = max(1, value);
+            else opts.threads_ = max(1, value);
+        }else if(arg.size() > 1 && arg[0] == '-'){
+            cerr << "Unknown option: " << arg << endl;
+            return false;
+        }else{
+            inputs.push_back(arg);
+        }
+    }
+    if(opts.grid_ && (opts.width_ <= 0 || opts.height_ <= 0)){
+        cerr << "-g needs both -w and -h" << endl;
+        return false;
+    }
+    return !inputs.empty();
+}
+
+// file name without directory and extension
+static string stem(const string& path){
+    string name = path.substr(path.find_last_of('/') + 1);
+    return name.substr(0, name.find_last_of('.'));
+}
+
+// runs in the worker process, the solver log and input errors go to <out>/<assay>.log and one summary line to summary_fd
+static int synthesize(const string& file, const CliOptions& opts, int summary_fd){
+    string base = opts.out_dir_ + "/" + stem(file);
+    if(freopen((base + ".log").c_str(), "w", stdout) == nullptr || dup2(fileno(stdout), STDERR_FILENO) < 0){
+        return 2;
+    }
+
+    auto before = chrono::steady_clock::now();
+    OnePassSynth synth(file);
+    if(!synth.get_errors().empty()){
+        string line = synth.get_errors().front() + "\n";
+        if(write(summary_fd, line.c_str(), line.size()) < 0){
+            return 2;
+        }
+        return 3;
+    }
+    synth.set_options(opts.solver_);
+    synth.set_limits(opts.width_, opts.height_, opts.time_);
+    synth.set_threads(opts.threads_);
+    // dot runs next to the solver, it is only waited for at the end
+    future<int> rendered;
+    if(opts.flow_diagram_){
+        rendered = synth.print_flow_diagram(base + ".dot");
+    }
+
+    bool is_sat;
+    if(opts.grid_){
+        is_sat = synth.solve_grid(opts.width_, opts.height_, synth.get_solver().get_time_limit());
+    }else{
+        is_sat = synth.solve();
+    }
+    auto after = chrono::steady_clock::now();
+    auto time_used = chrono::duration_cast<chrono::milliseconds>(after - before).count();
+
+    Solver& solver = synth.get_solver();
+    if(is_sat){
+        solver.save_solution(base + ".sol");
+        solver.save_trace(base + ".trace");
+    }
+    // candidates that ran out of time or memory were passed over
+    int skipped = synth.get_stats().no_of_skipped();
+    cout << (is_sat ? "Sat" : skipped > 0 ? "Unknown" : "Unsat") << " in " << time_used << "ms" << endl;
+    if(opts.stats_){
+        ofstream stats(base + ".stats.json");
+        stats << synth.get_stats_json() << endl;
+    }
+    if(rendered.valid() && rendered.get() != 0){
+        cout << "Could not render " << base << ".png, is graphviz installed?" << endl;
+    }
+
+    ostringstream summary;
+    if(is_sat){
+        summary << file << ": sat (w=" << solver.get_width() << ", h=" << solver.get_height() << ", t=" << solver.get_time() << ") in " << time_used << "ms";
+    }else{
+        summary << file << ": " << (skipped > 0 ? "unknown" : "unsat") << " in " << time_used << "ms";
+    }
+    if(skipped > 0){
+        summary << ", " << skipped << " candidates skipped" << (is_sat ? ", not proven optimal" : "");
+    }
+    summary << "\n";
+    // a single short write, so lines of concurrent workers do not interleave
+    string line = summary.str();
+    if(write(summary_fd, line.c_str(), line.size()) < 0){
+        return 2;
+    }
+    return is_sat ? 0 : 1;
+}
+
+int main(int argc, char* argv[]){
+    CliOptions opts;
+    vector<string> inputs;
+    if(!parse_args(argc, argv, opts, inputs)){
+        usage(argv[0]);
+        return 2;
+    }
+    vector<string> files;
+    if(!expand_inputs(inputs, files)){
+        return 2;
+    }
+    mkdir(opts.out_dir_.c_str(), 0755);
+    if(!opts.solver_.cache_dir_.empty()){
+        mkdir(opts.solver_.cache_dir_.c_str(), 0755);
+    }
+    cout.flush();
+
+    // every assay gets its own process: z3 state, stdout and crashes stay per assay
+    vector<pid_t> pids(files.size(), -1);
+    int summary_fd = dup(STDOUT_FILENO);
+    int running = 0, failed = 0;
+    size_t next = 0;
+    while(next < files.size() || running > 0){
+        if(next < files.size() && running < opts.jobs_){
+            pid_t pid = fork();
+            if(pid == 0){
+                _exit(synthesize(files[next], opts, summary_fd));
+            }
+            if(pid < 0){
+                cerr << files[next] << ": cannot start worker" << endl;
+                failed++;
+            }else{
+                pids[next] = pid;
+                running++;
+            }
+            next++;
+            continue;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if(pid < 0){
+            break;
+        }
+        running--;
+        size_t idx = find(pids.begin(), pids.end(), pid) - pids.begin();
+        if(WIFSIGNALED(status)){
+            cout << files[idx] << ": worker killed by signal " << WTERMSIG(status) << endl;
+            failed++;
+        }else if(WEXITSTATUS(status) == 3){
+            // input errors, already summarized by the worker
+            failed++;
+        }else if(WEXITSTATUS(status) > 1){
+            cout << files[idx] << ": failed, see " << opts.out_dir_ << "/" << stem(files[idx]) << ".log" << endl;
+            failed++;
+        }
+    }
+    close(summary_fd);
+    return failed > 0 ? 2 : 0;
+}
@@ -0,0 +1,35 @@
+#-------------------------------------------------
+#
+# Headless synthesis driver, no Qt needed at run time
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = synth
+TEMPLATE = app
+
+CONFIG += console c++11 thread
+CONFIG -= app_bundle qt
+INCLUDEPATH += . ./include
+LIBS += -lz3
+
+# app.pro builds the same sources with its own flags
+OBJECTS_DIR = build-cli
+
+SOURCES += \
+        cli.cc \
+        Architecture.cc \
+        Solver.cc \
+        SolutionCache.cc \
+        SolutionTrace.cc \
+        DriverUtil.cc
+
+HEADERS += \
+        include/Architecture.h \
+        include/Module.h \
+        include/Solver.h \
+        include/SolutionCache.h \
+        include/SolutionTrace.h \
+        include/DriverUtil.h \
+        include/OnePassSynth.h
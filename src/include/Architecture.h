@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <future>
 
 class Architecture {
 public:
@@ -26,7 +27,38 @@ public:
     // read in the file and subtract id by 1 to make it start from 0
     Architecture();
     Architecture(const std::string& filename);
-    void build_from_file(const std::string &filename);
-    void print_to_graph(std::string filename);
+    // false if the file has errors, they are printed and kept in errors_ as file:line:col: message
+    bool build_from_file(const std::string &filename);
+    // the same from the contents of a file, filename only names it in errors
+    bool build_from_text(const std::string& filename, const std::string& buffer);
+    std::vector<std::string> errors_;
+    // writes the flow diagram to filename.dot and, with render, runs dot -Tpng in the background;
+    // the future holds the exit status of dot
+    std::future<int> print_to_graph(std::string filename, bool render = true);
+
+    // time window of droplet (edge) i: it only needs to be on the grid during
+    // [earliest_[i], T - slack_[i]] for a horizon of T time steps
+    std::vector<int> earliest_;
+    std::vector<int> slack_;
+    void compute_time_windows();
+    // absolute last step droplet i may be on the grid, whatever the horizon; empty unless scheduled
+    std::vector<int> deadline_;
+
+    // List schedule of the MIX and DETECT operations for a width x height grid: by priority
+    // (critical path to the end), each as early as its inputs, the area left for mixers and
+    // its detector allow, with route steps to carry a droplet from one operation to the next.
+    // The windows become those of the schedule, each operation may run up to spare steps late,
+    // and the returned horizon finishes it; route and spare trade tightness for freedom.
+    int schedule(int width, int height, int route, int spare);
+
+    // lower bound on the completion time: critical path over the MIX/DETECT durations
+    int min_time();
+
+    // everything the encoding reads, nodes, modules and edges in index order with labels replaced
+    // by module ids; assays differing only in names, comments or layout of the file give the same text
+    std::string canonical() const;
+
+private:
+    void add_error(const std::string& filename, int line, int col, const std::string& msg);
 
 };
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Solver.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+// command line handling shared by synth and bench
+
+// the whole of s as a decimal number
+bool parse_int(const char* s, int& value);
+
+// the options that set SolverOptions, --backend, --objective and so on. Reads the option at argv[i]
+// and moves i past its value: 1 if it is one of them, 0 if it is not, -1 with a message on cerr
+// if its value is missing or wrong
+int parse_solver_option(int argc, char* argv[], int& i, SolverOptions& opts);
+// their lines of the usage text
+void solver_options_usage(std::ostream& out);
+
+// the inputs with every directory replaced by the regular files in it, in name order; hidden files and
+// the flow diagrams the app writes next to the assays are left out. False with a message on cerr if
+// an input does not exist
+bool expand_inputs(const std::vector<std::string>& inputs, std::vector<std::string>& files);
@@ -12,6 +12,12 @@ enum Type {
     DETECTOR
 };
 
+// what is at a perimeter position of a solution
+struct Node {
+    int type_; // 0 - empty, 1 - sink, 2 - dispenser
+    std::string label_;
+};
+
 struct Module {
     int id_;
     Type type_;
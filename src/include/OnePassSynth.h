@@ -5,23 +5,56 @@
 
 #include <string>
 #include <vector>
+#include <iostream>
 #include "z3++.h"
 
 class OnePassSynth {
 public:
-    OnePassSynth(std::string filename): filename_(filename), ctx_(), arc_(filename_), solver_(arc_, ctx_) {}
+    OnePassSynth(std::string filename): filename_(filename), ctx_(), arc_(filename_), solver_(arc_, ctx_), threads_(1) {}
     
     // solve according to the limit set in input file
-    bool solve() { return solver_.solve(); }
+    bool solve();
+
+    // backend and objective used by every solve
+    void set_options(const SolverOptions& options) { solver_.set_options(options); }
+
+    // limits used instead of the ones in the input file, values <= 0 keep them
+    void set_limits(int width, int height, int time) { solver_.set_limits(width, height, time); }
+
+    // report every checked candidate, see Solver::set_progress_callback()
+    void set_progress_callback(ProgressCallback progress) { solver_.set_progress_callback(progress); }
+
+    // seed the next solves with the solution of previous, see Solver::set_hint()
+    bool set_hint(OnePassSynth& previous) { return solver_.set_hint(previous.solver_); }
+
+    // stop a running solve from another thread
+    void interrupt() { solver_.interrupt(); }
+    bool is_interrupted() { return solver_.is_interrupted(); }
+
+    // number of grids solved concurrently by solve(), 1 solves them in order on this thread
+    void set_threads(int threads) { threads_ = threads; }
+    int get_threads() { return threads_; }
 
     // solve under these conditions
     bool solve(int width, int height, int time) { return solver_.solve(width, height, time); }
 
+    // solve with the smallest time in [time_lo, time_hi] for this grid
+    bool solve_min_time(int width, int height, int time_lo, int time_hi) { return solver_.solve_min_time(width, height, time_lo, time_hi); }
+
+    // solve this grid within time_hi, decomposed if the options say so
+    bool solve_grid(int width, int height, int time_hi) { return solver_.solve_grid(width, height, time_hi); }
+
+    // time steps of the current solution
+    int get_time() { return solver_.get_time(); }
+
     // print solution to screen
     void print_solution() { solver_.print_solution(); }
 
-    // print flow diagrm to filename.dot
-    void print_flow_diagram(std::string filename) { arc_.print_to_graph(filename); }
+    // binary trace of the solution, see TraceReader
+    bool save_trace(std::string filename) { return solver_.save_trace(filename); }
+
+    // print flow diagram to filename.dot and render filename.png in the background
+    std::future<int> print_flow_diagram(std::string filename) { return arc_.print_to_graph(filename); }
     
     // return matrix[time][m][n], -3: empty, -2: mixing, -1: detecting, >=0: droplet ids
     std::vector<std::vector<std::vector<int>>> get_grid() { return solver_.get_grid(); }
@@ -36,11 +69,30 @@ public:
     // return detectors[x][y] (flag, label)
     std::vector<std::vector<std::pair<bool, std::string>>> get_detector_pos() { return solver_.get_detector_pos(); }
 
-    Solver get_solver() { return solver_; }
+    Solver& get_solver() { return solver_; }
+
+    // per phase and per candidate record of the solves so far, see Solver::get_stats()
+    const SolverStats& get_stats() { return solver_.get_stats(); }
+    std::string get_stats_json() { return solver_.get_stats().to_json(); }
+
+    // problems found reading the input file as file:line:col: message, nothing can be solved unless empty
+    const std::vector<std::string>& get_errors() { return arc_.errors_; }
 
 private:
     std::string filename_;
     z3::context ctx_;
     Architecture arc_;
     Solver solver_;
+    int threads_;
 };
+
+inline bool OnePassSynth::solve(){
+    if(threads_ <= 1){
+        return solver_.solve();
+    }
+    bool res = solver_.solve_portfolio(threads_);
+    if(res){
+        std::cout << "Portfolio winner: (w=" << solver_.get_width() << ", h=" << solver_.get_height() << ", t=" << solver_.get_time() << ")" << std::endl;
+    }
+    return res;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// what is kept of a checked (width, height, time) candidate, the arrays as Solver decodes them
+struct CachedSolution {
+    bool sat_;
+    std::vector<int> cells_;     // [t][y][x]
+    std::vector<int> ports_;     // [p]
+    std::vector<int> detectors_; // [y][x]
+
+    CachedSolution(): sat_(false) {}
+};
+
+// sat solutions and unsat verdicts kept on disk across runs. Entries are files in dir named
+// after a hash of the key and the candidate, the key itself is stored too so collisions miss.
+// Several processes may share dir, an entry is written to a temporary file and renamed.
+class SolutionCache {
+private:
+    std::string dir_;
+    std::string key_;
+    std::string hash_;
+
+    std::string path(int width, int height, int time);
+
+public:
+    // key: everything the result depends on besides the candidate
+    SolutionCache(const std::string& dir, const std::string& key);
+
+    bool load(int width, int height, int time, CachedSolution& res);
+    // best effort, an entry that cannot be written is left out
+    void store(int width, int height, int time, const CachedSolution& sol);
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Module.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+// Binary trace of a solution, everything the GUI shows and nothing it has to solve for.
+// All numbers are unsigned LEB128 varints:
+//   "DMFBTRC1" width height frames labels
+//   labels x (length, bytes)
+//   perimeter x (type, label + 1)      type as in Node, label 0 for none
+//   width * height x (label + 1)       detector placed at the cell, row-major
+//   frames x frame                     frames = time + 1
+// A frame is a kind byte followed by the cells, a cell stored as value + 3 (get_grid() values):
+//   TRACE_KEY    width * height cells, row-major
+//   TRACE_DELTA  count, count x (index gap, cell), only the cells that changed since the previous frame
+// A key frame comes at least every TRACE_KEY_INTERVAL frames, so any frame is a few deltas away.
+#define TRACE_MAGIC "DMFBTRC1"
+#define TRACE_KEY 0
+#define TRACE_DELTA 1
+#define TRACE_KEY_INTERVAL 32
+
+// cells: [t][y][x] as Solver decodes them, the placements as get_sink_dispenser_pos() and
+// get_detector_pos() return them; false if the file cannot be written
+bool write_trace(const std::string& filename, int width, int height, int time, const std::vector<int>& cells,
+                 const std::vector<Node>& sink_dispensers, const std::vector<std::vector<std::pair<bool, std::string>>>& detectors);
+
+// Steps through a trace in memory without copying it, the data has to outlive the reader
+// (a memory-mapped file for instance). Stepping forward applies one delta, anything else
+// replays from the key frame at or before the target.
+class TraceReader {
+private:
+    const unsigned char* data_;
+    const unsigned char* end_;
+    int width_;
+    int height_;
+    std::vector<Node> sink_dispensers_;
+    std::vector<std::vector<std::pair<bool, std::string>>> detectors_;
+    std::vector<const unsigned char*> frames_; // where frame t starts
+    std::vector<int> key_;                     // latest key frame at or before t
+    std::vector<int> cells_;                   // of frame cur_
+    int cur_;
+    std::string error_;
+
+    bool apply(int t); // frame t on top of cells_
+
+public:
+    TraceReader(): data_(nullptr), end_(nullptr), width_(0), height_(0), cur_(-1) {}
+
+    // reads the header and indexes the frames, false with get_error() set if it is no valid trace
+    bool open(const unsigned char* data, size_t size);
+    const std::string& get_error() { return error_; }
+
+    int get_width() { return width_; }
+    int get_height() { return height_; }
+    int get_frames() { return frames_.size(); }
+    const std::vector<Node>& get_sink_dispenser_pos() { return sink_dispensers_; }
+    const std::vector<std::vector<std::pair<bool, std::string>>>& get_detector_pos() { return detectors_; }
+
+    // grid[y][x] at frame t, like get_grid()[t]
+    bool frame(int t, std::vector<std::vector<int>>& grid);
+};
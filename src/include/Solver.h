@@ -2,36 +2,262 @@
 
 #include "z3++.h"
 #include "Architecture.h"
+#include "SolutionCache.h"
+#include "SolutionTrace.h"
 
 #include <vector>
 #include <string>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <tuple>
 
-struct Node {
-    int type_; // 0 - empty, 1 - sink, 2 - dispenser
-    std::string label_;
+// how the constraints are handed to z3
+enum Backend {
+    OPTIMIZE, // z3::optimize with pseudo-Boolean atmost/atleast
+    SAT       // plain z3::solver on clauses, cardinalities as sequential counters
 };
 
+// what is asked of a sat horizon besides a solution
+enum Objective {
+    FEASIBLE, // any solution
+    MINIMIZE, // the solution with the fewest actions
+    STAGED    // any solution first, then fewer actions until stage_budget_ms_ runs out
+};
+
+struct SolverOptions {
+    Backend backend_;
+    Objective objective_;
+    int stage_budget_ms_; // for STAGED, <= 0 tightens until unsat
+    // only search one of the mirrored/rotated layouts and one order of interchangeable droplets
+    bool symmetry_breaking_;
+    // mixing^t and detecting^t only for the mixer and detector nodes. Otherwise every node has them and
+    // the objective counts them all, those of the other nodes are free and only ever false. The verdicts
+    // are the same, but z3::optimize takes another path to the fewest actions, neither one faster overall
+    bool sparse_actions_;
+    // sat solutions and unsat verdicts are kept here across runs, "" for no cache
+    std::string cache_dir_;
+    // time for the check of one candidate, 0 for none. One that runs out is retried up to
+    // check_retries_ times with twice the time before, then skipped as if it were unsat
+    unsigned check_timeout_ms_;
+    int check_retries_;
+    // z3's memory limit in MB, 0 for none. z3 keeps one limit for the whole process
+    unsigned max_memory_mb_;
+    // what solve() minimizes over grids and horizons, nondecreasing in each argument.
+    // Empty for the area alone, the first grid of the smallest area that is sat wins
+    std::function<double(int width, int height, int time)> grid_cost_;
+    // solve() schedules the operations first and then places and routes window_ steps at a time,
+    // the first window_ - window_overlap_ of them fixed once the window is sat. Not the smallest
+    // horizon, but the encoding only holds each droplet for the steps the schedule gives it
+    bool decompose_;
+    int window_;
+    int window_overlap_;
+
+    SolverOptions(): backend_(OPTIMIZE), objective_(MINIMIZE), stage_budget_ms_(1000), symmetry_breaking_(false),
+        sparse_actions_(false), check_timeout_ms_(0), check_retries_(1), max_memory_mb_(0),
+        decompose_(false), window_(12), window_overlap_(4) {}
+};
+
+// the kinds of variables, they tell the VarTensor symbols apart
+enum VarKind {
+    VAR_NONE,
+    VAR_C,
+    VAR_PRESENT,
+    VAR_MIXING,
+    VAR_DETECTOR,
+    VAR_DETECTING,
+    VAR_DISPENSER,
+    VAR_SINK
+};
+
+// the parts of building and checking an encoding that Solver times
+enum Phase {
+    PHASE_INIT,        // grid-level variables
+    PHASE_EXTEND,      // time-indexed variables
+    PHASE_PLACEMENT,   // add_placement_constraints
+    PHASE_SYMMETRY,    // add_symmetry_breaking, add_droplet_order
+    PHASE_CONSISTENCY, // add_consistency_constraints
+    PHASE_MOVEMENT,    // add_movement
+    PHASE_FLUIDIC,     // add_fluidic_constraints
+    PHASE_HORIZON,     // add_objectives, add_time_windows and the action count of check()
+    PHASE_CHECK,       // z3, with tighten_actions()
+    PHASE_DECODE,      // decode_model
+    NO_OF_PHASES
+};
+
+// "init", "extend", ... as used in benchmark output
+const char* phase_name(Phase phase);
+
+// adds the time until it goes out of scope to ms
+class PhaseTimer {
+private:
+    double& ms_;
+    std::chrono::steady_clock::time_point start_;
+public:
+    PhaseTimer(double& ms): ms_(ms), start_(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer() { ms_ += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count(); }
+};
+
+// one phase, summed over every candidate
+struct PhaseStats {
+    double ms_;
+    long long assertions_; // added to the solver
+    long long vars_;       // created, with the auxiliary ones of the cardinality encodings
+
+    PhaseStats(): ms_(0), assertions_(0), vars_(0) {}
+};
+
+// one (width, height, time) candidate checked by Solver::solve(width, height, time)
+struct CheckStats {
+    int width_, height_, time_;
+    std::string result_; // "sat", "unsat" or "unknown"
+    std::string reason_; // why it is unknown: "timeout", "interrupted", z3's message, ...
+    bool cached_;        // answered by the solution cache, nothing was built or checked
+    bool implied_;       // unsat because a candidate that dominates it is, nothing was built or checked
+    double build_ms_;    // encoding, the phases before PHASE_CHECK
+    double check_ms_;
+    // z3's statistics of the check by name: conflicts, decisions, memory, ...
+    std::vector<std::pair<std::string, double>> z3_;
+
+    CheckStats(): width_(0), height_(0), time_(0), cached_(false), implied_(false), build_ms_(0), check_ms_(0) {}
+};
+
+// what a Solver has done since it was created or reset_stats() was called
+struct SolverStats {
+    PhaseStats phases_[NO_OF_PHASES];
+    std::vector<CheckStats> checks_;
+
+    // the phases and checks of other, e.g. a portfolio worker, count as these
+    void add(const SolverStats& other);
+    // unknown checks other than interrupted ones, a result is only proven optimal without them
+    int no_of_skipped() const;
+    // {"phases": {"init": {"ms": .., "assertions": .., "vars": ..}, ...}, "checks": [{"width": .., ...}, ...]}
+    std::string to_json() const;
+};
+
+// s as a JSON string literal, quotes included; to_json() and the bench rows use it
+std::string json_string(const std::string& s);
+
+// bool variables of one kind in a single block, row-major over up to four coordinates.
+// The first coordinate is outermost, so the time indexed ones grow a layer at a time.
+// Variables are named by an int symbol, var_name() gives them their readable name.
+class VarTensor {
+private:
+    std::vector<z3::expr> vars_;
+    int kind_;
+    int d1_, d2_, d3_; // extents of the inner coordinates
+    int no_of_vars_;   // entries that are variables, not constants
+public:
+    // symbols are SYMBOL_BASE | kind << KIND_SHIFT | index, z3 numbers its own k!<n> constants from 0
+    static const int SYMBOL_BASE = 1 << 29;
+    static const int KIND_SHIFT = 26;
+
+    VarTensor(): kind_(VAR_NONE), d1_(1), d2_(1), d3_(1), no_of_vars_(0) {}
+
+    // drop everything, layers of d1 x d2 x d3 are added from here on
+    void reset(VarKind kind, int d1, int d2 = 1, int d3 = 1) {
+        vars_.clear();
+        kind_ = kind;
+        d1_ = d1;
+        d2_ = d2;
+        d3_ = d3;
+        no_of_vars_ = 0;
+    }
+    void reserve(int layers) { vars_.reserve((size_t)layers * layer_size()); }
+    int layer_size() const { return d1_ * d2_ * d3_; }
+    int size() const { return vars_.size(); }
+    int no_of_vars() const { return no_of_vars_; }
+
+    int index(int a, int b = 0, int c = 0, int d = 0) const { return ((a*d1_ + b)*d2_ + c)*d3_ + d; }
+    void coords(int idx, int& a, int& b, int& c, int& d) const {
+        d = idx % d3_; idx /= d3_;
+        c = idx % d2_; idx /= d2_;
+        b = idx % d1_;
+        a = idx / d1_;
+    }
+    z3::expr& operator()(int a, int b = 0, int c = 0, int d = 0) { return vars_[index(a, b, c, d)]; }
+    z3::expr& operator[](int idx) { return vars_[idx]; }
+
+    // append the next index: a new variable, or a constant for one that is decided already.
+    // An index past the KIND_SHIFT bits would name another variable, the encoding is too large then
+    void add_var(z3::context& ctx) {
+        if(size() >= (1 << KIND_SHIFT)){
+            throw z3::exception("too many variables of one kind for their symbols");
+        }
+        vars_.push_back(ctx.constant(ctx.int_symbol(SYMBOL_BASE | (kind_ << KIND_SHIFT) | size()), ctx.bool_sort()));
+        no_of_vars_++;
+    }
+    void add_const(const z3::expr& e) { vars_.push_back(e); }
+    // back to the first layers, the variables of the others are dropped
+    void truncate(int layers) {
+        size_t size = std::min(vars_.size(), (size_t)layers * layer_size());
+        for(size_t k = size; k < vars_.size(); k++){
+            if(vars_[k].decl().decl_kind() == Z3_OP_UNINTERPRETED){
+                no_of_vars_--;
+            }
+        }
+        vars_.erase(vars_.begin() + size, vars_.end());
+    }
+};
+
+// called after every check with the candidate, the time it took and whether it was sat;
+// reason says why for an unknown one ("timeout", "interrupted", ...) and is empty otherwise
+typedef std::function<void(int width, int height, int time, long long ms, bool sat, const std::string& reason)> ProgressCallback;
+
 class Solver {
 private:
     // c^t_(x,y,id)
     // c_ used for droplets only
     // no of droplets = no of edges
     // droplet id = edge id
-    std::vector<std::vector<std::vector<std::vector<z3::expr>>>> c_;
+    VarTensor c_;
+    // present^t_(id) == OR_(x,y) c^t_(x,y,id), droplet id is somewhere on the grid at t
+    VarTensor present_;
     // mixing^t_(x,y,i)
-    std::vector<std::vector<std::vector<std::vector<z3::expr>>>> mixing_;
+    VarTensor mixing_;
     // dectector_(x,y,l)
-    std::vector<std::vector<std::vector<z3::expr>>> detector_;
+    VarTensor detector_;
     // detecting^t_(i)
-    std::vector<std::vector<z3::expr>> detecting_;
+    VarTensor detecting_;
     // dispenser_(p,l)
-    std::vector<std::vector<z3::expr>> dispenser_;
-    // sink(p)
-    std::vector<std::vector<z3::expr>> sink_;
+    VarTensor dispenser_;
+    // sink(p,l)
+    VarTensor sink_;
 
+    SolverOptions options_;
     z3::optimize solver_;
+    z3::solver sat_solver_; // used instead of solver_ by the SAT backend
+    int no_of_aux_; // auxiliary variables of the cardinality encodings
+    int no_of_assertions_; // added to the current encoding by add()
+
+    SolverStats stats_;
+    Phase phase_; // the phase that add() counts assertions for
+    std::vector<std::pair<std::string, double>> last_z3_stats_; // of the last check()
+    void record_z3_stats();
+    double build_ms(); // of all phases before PHASE_CHECK
+    // times a phase until the end of the scope, with the assertions and variables added meanwhile
+    class PhaseScope {
+    private:
+        Solver& solver_;
+        Phase phase_;
+        Phase previous_;
+        int vars_before_;
+        PhaseTimer timer_;
+    public:
+        PhaseScope(Solver& solver, Phase phase): solver_(solver), phase_(phase), previous_(solver.phase_),
+            vars_before_(solver.get_no_of_vars()), timer_(solver.stats_.phases_[phase].ms_) { solver.phase_ = phase; }
+        ~PhaseScope() {
+            solver_.stats_.phases_[phase_].vars_ += solver_.get_no_of_vars() - vars_before_;
+            solver_.phase_ = previous_;
+        }
+    };
+    // every action variable created so far, counted by no_of_actions_
+    z3::expr_vector actions_;
     z3::expr no_of_actions_;
     z3::optimize::handle optimize_handle_;
     
@@ -46,37 +272,180 @@ private:
     int height_cur_;
     int perimeter_cur_; // = (width_cur_ + height_cur_) * 2
     int time_cur_;
+    int width_built_; // grid size the current encoding is built for, -1 if none
+    int height_built_;
     z3::check_result result_;
     z3::model model_;
+    std::string reason_unknown_; // of result_
+    z3::expr_vector fixed_; // assumed by every check, literals of steps fixed by solve_decomposed()
+    // a prior solution, see set_hint(); empty cells_ for none
+    CachedSolution hint_;
+    int hint_width_, hint_height_, hint_time_;
+    // its ports, detectors and droplet positions that exist on the current grid and horizon
+    z3::expr_vector hint_literals();
+    // run_check() assuming the hint, literals in an unsat core are dropped and it is checked again
+    z3::check_result run_hinted_check();
+    unsigned check_budget_ms_; // timeout of the current check, 0 for none
+    std::atomic<bool> interrupted_;
+    ProgressCallback progress_;
 
     Architecture& arch_;
     z3::context& ctx_;
 
-    void init(int width, int height, int time);
+    // the encoding of a width x height grid is built once by init(), extend() then
+    // appends time steps to it so that the horizon can grow without re-encoding
+    void init(int width, int height);
+    void extend(int time);
+    bool check(); // check with horizon time_cur_ in a push/pop scope
+
+    // horizons the encoding can go back to, each one keeps what came after it in a scope of its own
+    struct HorizonMark {
+        int time_;
+        unsigned no_of_actions_; // actions_ at time_
+        int no_of_aux_;
+        int no_of_assertions_;
+    };
+    std::vector<HorizonMark> marks_;
+    void mark_horizon(); // at time_cur_
+    bool rewind(int time); // to the latest mark at or before time, false if there is none
 
-    void add_constraints(); // all the constraints
-    void add_consistency_constraints();
+    // assert e on, push and pop the solver of the current backend
+    void add(const z3::expr& e);
+    void push();
+    void pop();
+    z3::check_result run_check(); // model_ is set when sat
+    void set_timeout(unsigned ms); // of every following check, 0 for none
+    // cardinality constraints, pseudo-Boolean for OPTIMIZE and sequential counters for SAT
+    z3::expr at_most(const z3::expr_vector& vec, int k);
+    z3::expr at_least(const z3::expr_vector& vec, int k);
+    int count_actions(); // in model_
+    void fix_steps(int t_from, int t_to); // the variables of these steps to their value in model_
+    // lower the number of actions while it stays sat, for at most budget_ms (<= 0: no limit)
+    void tighten_actions(int budget_ms);
+
+    void add_constraints(int t_from, int t_to); // constraints of time steps [t_from, t_to]
+    void add_consistency_constraints(int t_from, int t_to);
     void add_placement_constraints();
-    void add_movement();
-    void add_objectives(); 
-    void add_fluidic_constraints();
+    void add_movement(int t_from, int t_to);
+    void add_objectives(); // only valid at the horizon, added inside the check scope
+    void add_time_windows(); // droplets that are too late for the horizon, same scope
+    void add_fluidic_constraints(int t_from, int t_to);
+    void add_symmetry_breaking(); // placements are the lex-smallest of their symmetric copies
+    void add_droplet_order(int t_from, int t_to); // interchangeable droplets appear in id order
+
+    // the model read once into dense arrays, on first use after every new model
+    bool decoded_;
+    std::vector<int> cells_;     // [t][y][x]: -3 empty, -2 mixing, -1 detecting, >=0 droplet id
+    std::vector<int> ports_;     // [p]: node id of the dispenser or sink at perimeter position p, -1 none
+    std::vector<int> detectors_; // [y][x]: node id of the detector placed there, -1 none
+    void decode_model();
+    int cell(int t, int x, int y) { return cells_[(t*height_cur_ + y)*width_cur_ + x]; }
+
+    // the verdicts of earlier runs with the same assay and options, created on first use
+    std::unique_ptr<SolutionCache> cache_;
+    // true with result_ set if the candidate is cached, a sat one becomes the current solution
+    bool load_cached(int width, int height, int time);
+    void store_cached(); // result_ of the current candidate, if it is sat or unsat, but no hinted solution
+    // make a decoded solution the current one, sol is left empty
+    void set_solution(int width, int height, int time, CachedSolution& sol);
+
+    // the grids solve() tries: those that hold every mixer, by the least cost they can have
+    std::vector<std::pair<int, int>> candidate_grids();
+    double grid_cost(int width, int height, int time);
+    // largest horizon up to time_limit_ that costs less than best on this grid, 0 for none
+    int max_useful_time(int width, int height, double best);
+    // one try of solve_decomposed(): the windows of a schedule for this grid, false if they cannot
+    // all be solved. The solution becomes the current one
+    bool place_and_route(Architecture& scheduled, int width, int height, int horizon);
+    // unsat candidates (width, height, time); a shorter horizon on the same grid, or on the
+    // transposed one when that maps solutions to solutions, is unsat without a check
+    std::vector<std::tuple<int, int, int>> unsat_;
+    bool implied_unsat(int width, int height, int time);
+
+    // c^t_(x,y,id) and so on for the int symbol of a VarTensor variable, "" for any other
+    std::string var_name(int symbol);
+    // text with every variable symbol k!<n> replaced by its name
+    std::string with_var_names(const std::string& text);
 
     bool is_point_inbound(int x, int y) { return (x >= 0) && (x < width_cur_) && (y >= 0) && (y < height_cur_); }
+    // perimeter position p is next to cell (x, y) on side 0 top, 1 right, 2 bottom, 3 left, and back
+    void perimeter_cell(int p, int& x, int& y, int& side) { perimeter_cell(width_cur_, height_cur_, p, x, y, side); }
+    void perimeter_cell(int w, int h, int p, int& x, int& y, int& side); // on a w x h grid
+    int perimeter_pos(int x, int y, int side) { return perimeter_pos(width_cur_, height_cur_, x, y, side); }
+    // steps from (x, y) to the closest cell on the border
+    int border_distance(int x, int y) { return std::min(std::min(x, y), std::min(width_cur_-1-x, height_cur_-1-y)); }
+    // window of droplet i at (x, y) for a horizon of time_cur_ steps
+    int earliest(int i, int x, int y);
+    int latest(int i, int x, int y);
 
 public:
     Solver(Architecture& arch, z3::context& c);
 
+    // perimeter position next to cell (x, y) of a w x h grid on side 0 top, 1 right, 2 bottom, 3 left.
+    // Clockwise from the top left corner, the order RenderArea draws the ports in
+    static int perimeter_pos(int w, int h, int x, int y, int side);
+
+    // the grid and horizon of least cost (SolverOptions::grid_cost_), smallest areas first
     bool solve();
     bool solve(int width, int height, int time);
     bool solve_from(int width, int height, int time);
+    // smallest sat horizon in [time_lo, time_hi], galloping up from the lower bound then bisecting.
+    // The grid is built once, a probe extends the encoding of the largest unsat horizon below it
+    bool solve_min_time(int width, int height, int time_lo, int time_hi);
+    // a solution on this grid by a list schedule and windowed place and route, within time_hi.
+    // If no schedule works out, solve_min_time() decides, so the verdict is the same as without
+    bool solve_decomposed(int width, int height, int time_hi);
+    // one grid as solve() does it: solve_decomposed() or solve_min_time() as the options say
+    bool solve_grid(int width, int height, int time_hi);
+    // same search as solve(), with each grid solved by one of threads workers in its own context
+    bool solve_portfolio(int threads);
+
+    // takes effect from the next grid that is built
+    void set_options(const SolverOptions& options);
+    const SolverOptions& get_options() { return options_; }
+
+    // override the limits read from the input file, values <= 0 keep them
+    void set_limits(int width, int height, int time);
+    int get_time_limit() { return time_limit_; }
+
+    // time, assertions and variables of each phase and a record of every candidate checked,
+    // accumulated until reset_stats(); the portfolio adds those of its workers
+    const SolverStats& get_stats() { return stats_; }
+    void reset_stats() { stats_ = SolverStats(); }
+    // size of the current encoding: its variables, the auxiliary ones among them, and assertions
+    int get_no_of_vars();
+    int get_no_of_aux() { return no_of_aux_; }
+    int get_no_of_assertions() { return no_of_assertions_; }
+
+    // the portfolio calls it from its worker threads
+    void set_progress_callback(ProgressCallback progress) { progress_ = progress; }
+
+    // stop the running check and any search it is part of, safe to call from another thread
+    void interrupt();
+    bool is_interrupted() { return interrupted_; }
+    // take over the solution of another solver, which may live in another context
+    void load_solution(Solver& other);
+    // seed the following checks with the solution of another solver of the same assay, on any grid
+    // and horizon: ports keep their side, cells and steps outside the new grid are left out. A check
+    // assumes the hint first and drops what contradicts it, so a solution close to the previous one
+    // is found quickly; the number of actions is then the least among those that keep the rest.
+    // False if other has no solution or solves another assay
+    bool set_hint(Solver& other);
+    void clear_hint() { hint_ = CachedSolution(); }
 
     z3::optimize& get_solver() { return solver_; }
     int get_no_of_actions() { return no_of_actions_; }
+    int get_width() { return width_cur_; }
+    int get_height() { return height_cur_; }
+    int get_time() { return time_cur_; }
 
+    // variables get their readable names only here
     void print_solver(std::ostream& out = std::cout); 
     void print_solution(std::ostream& out = std::cout);
     void save_solver(std::string filename);
     void save_solution(std::string filename);
+    // compact binary form of the solution that TraceReader replays, false if it cannot be written
+    bool save_trace(std::string filename);
     void generate_gif(std::string filename);
 
    // return matrix[time][m][n]
@@ -89,8 +458,26 @@ public:
     std::vector<std::vector<std::pair<bool, std::string>>> get_detector_pos();
 };
 
+inline void Solver::set_limits(int width, int height, int time){
+    if(width > 0){
+        width_limit_ = width;
+    }
+    if(height > 0){
+        height_limit_ = height;
+    }
+    if(time > 0){
+        time_limit_ = time;
+    }
+}
+
 inline void Solver::print_solver(std::ostream& out){
-    out << solver_ << std::endl;
+    std::ostringstream raw;
+    if(options_.backend_ == SAT){
+        raw << sat_solver_;
+    }else{
+        raw << solver_;
+    }
+    out << with_var_names(raw.str()) << std::endl;
 };
 
 inline void Solver::save_solver(std::string filename){
@@ -6,16 +6,19 @@
 #include <QLayout>
 #include <QLineEdit>
 #include <QSpinBox>
+#include <QCheckBox>
 #include <QGroupBox>
 #include <QTimer>
 #include <QFileDialog>
 #include <QStatusBar>
+#include <QFile>
 
 #include <string>
 #include <vector>
 
 #include "OnePassSynth.h"
 #include "renderarea.h"
+#include "solvethread.h"
 #include "Solver.h"
 
 class MainWindow : public QMainWindow
@@ -39,16 +42,22 @@ private:
     
     QPushButton *selectInputBtn;
     QPushButton *runBtn;
+    QPushButton *cancelBtn;
     QPushButton *saveModelBtn;
     QPushButton *saveResultBtn;
+    QPushButton *openResultBtn;
     
     QSpinBox* widthInput;
     QSpinBox* heightInput;
     QSpinBox* timeInput;
+    QCheckBox* flowDiagramBox;
     
     QPushButton *nextStepBtn;
     QPushButton *prevStepBtn;
     QPushButton *restartBtn;
+    QPushButton *playBtn;
+    QSpinBox* fpsInput;
+    QTimer *playTimer; // steps forward while playing
 
     QStatusBar *bar;
 
@@ -58,23 +67,39 @@ private:
     
     // solver
     OnePassSynth *solver;
+    SolveThread *solveThread;
 
     // data from solver
     std::vector<std::vector<std::vector<int>>> gridData;
+    std::vector<std::vector<int>> traceFrame; // decoded from the trace, reused between steps
     std::vector<Node> sinkDispData;
     std::vector<std::vector<std::pair<bool, std::string>>> detectorData;
 
+    // a saved result replayed from its memory-mapped trace instead of gridData
+    QFile traceFile;
+    TraceReader trace;
+    bool showingTrace;
+
     int currentStep;
+    int stepCount() { return showingTrace ? trace.get_frames() : gridData.size(); }
     
     void onSelectInput();
     void onRun();
+    void onCancel();
+    void onProgress(int width, int height, int time, qint64 ms, bool sat, QString reason);
+    void onSolved(bool sat);
     void onSaveModel();
     void onSaveResult();
+    void onOpenResult();
     void onNextStep();
     void onPrevStep();
     void onRestart();    
+    void onPlay();
+    void onPlayTick();
+    void stopPlaying();
     
-    void paint();
+    // false if the trace frame of currentStep cannot be decoded, playback stops and the status bar says why
+    bool paint();
 };
 
 #endif // MAINWINDOW_H
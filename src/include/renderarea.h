@@ -33,6 +33,11 @@ public:
     std::vector<std::vector<std::pair<bool, std::string>>> detectorData;
     void do_update() { update(); }
 
+    // placements of the solution shown, repaints everything
+    void setPlacements(const std::vector<Node>& sinkDisp, const std::vector<std::vector<std::pair<bool, std::string>>>& detectors);
+    // grid of the step shown, only the cells that differ from the one on screen are repainted
+    void setFrame(const std::vector<std::vector<int>>& grid);
+
 protected:
     void paintEvent(QPaintEvent *event) override;
 
@@ -59,6 +64,19 @@ private:
     QImage empty_img;
     QRect empty_src;
 
+    // the images above cut out and scaled to spriteSize once, painting then only copies them
+    int spriteSize;
+    QPixmap droplet_pix;
+    QPixmap detector_pix;
+    QPixmap detecting_pix;
+    QPixmap dispenser_pix;
+    QPixmap sink_pix;
+    QPixmap mixing_pix;
+    QPixmap empty_pix;
+    void scaleSprites(int D);
+
+    int cellSize() { return width() / (gridData.size()+2); }
+
 };
 
 #endif // RENDERAREA_H
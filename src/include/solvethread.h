@@ -0,0 +1,30 @@
+#ifndef SOLVETHREAD_H
+#define SOLVETHREAD_H
+
+#include <QThread>
+
+#include "OnePassSynth.h"
+
+// runs OnePassSynth::solve_min_time() off the GUI thread and reports every checked candidate
+class SolveThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    SolveThread(OnePassSynth *solver, int width, int height, int time, QObject *parent = nullptr);
+
+signals:
+    void progress(int width, int height, int time, qint64 ms, bool sat, QString reason); // reason: see ProgressCallback
+    void solved(bool sat);
+
+protected:
+    void run() override;
+
+private:
+    OnePassSynth *solver;
+    int width;
+    int height;
+    int time;
+};
+
+#endif // SOLVETHREAD_H
@@ -17,15 +17,21 @@ MainWindow::MainWindow(QWidget *parent) :
     
     selectInputBtn = new QPushButton(this);
     runBtn = new QPushButton(this);
+    cancelBtn = new QPushButton(this);
     saveModelBtn = new QPushButton(this);
     saveResultBtn = new QPushButton(this);
+    openResultBtn = new QPushButton(this);
     nextStepBtn = new QPushButton(this);
     prevStepBtn = new QPushButton(this);
     restartBtn = new QPushButton(this);
+    playBtn = new QPushButton(this);
+    fpsInput = new QSpinBox(this);
+    playTimer = new QTimer(this);
     
     widthInput = new QSpinBox(this);
     heightInput = new QSpinBox(this);
     timeInput = new QSpinBox(this);
+    flowDiagramBox = new QCheckBox(this);
 
     auto labelWidth = new QLabel(this);
     auto labelHeight = new QLabel(this);
@@ -36,11 +42,19 @@ MainWindow::MainWindow(QWidget *parent) :
     
     selectInputBtn->setText("Select Input");
     runBtn->setText("Run");
+    cancelBtn->setText("Cancel");
+    cancelBtn->setEnabled(false);
     saveModelBtn->setText("Save Model");
     saveResultBtn->setText("Save Result");
+    openResultBtn->setText("Open Result");
     nextStepBtn->setText("Next");
     prevStepBtn->setText("Previous");
     restartBtn->setText("Restart");
+    playBtn->setText("Play");
+    fpsInput->setRange(1, 60);
+    fpsInput->setValue(5);
+    fpsInput->setSuffix(" fps");
+    flowDiagramBox->setText("Flow Diagram");
 
     widthInput->setMinimum(1);
     heightInput->setMinimum(1);
@@ -52,13 +66,16 @@ MainWindow::MainWindow(QWidget *parent) :
     controlPanel->addWidget(selectInputBtn, 1, 1);
     controlPanel->addWidget(saveModelBtn, 1, 2);
     controlPanel->addWidget(saveResultBtn, 1, 3);
+    controlPanel->addWidget(openResultBtn, 1, 4);
+    controlPanel->addWidget(flowDiagramBox, 1, 5);
     controlPanel->addWidget(labelWidth, 2, 1);
     controlPanel->addWidget(widthInput, 2, 2);
     controlPanel->addWidget(labelHeight, 2, 3);
     controlPanel->addWidget(heightInput, 2, 4);
     controlPanel->addWidget(labelTime, 3, 1);
     controlPanel->addWidget(timeInput, 3, 2);
-    controlPanel->addWidget(runBtn, 3, 3, 1, 2);
+    controlPanel->addWidget(runBtn, 3, 3);
+    controlPanel->addWidget(cancelBtn, 3, 4);
 
     mainBox->addLayout(controlPanel);
 
@@ -66,6 +83,8 @@ MainWindow::MainWindow(QWidget *parent) :
     mediaControl->addWidget(nextStepBtn);
     mediaControl->addWidget(prevStepBtn);
     mediaControl->addWidget(restartBtn);
+    mediaControl->addWidget(playBtn);
+    mediaControl->addWidget(fpsInput);
     mainBox->addLayout(mediaControl);
 
     render = new RenderArea;
@@ -81,13 +100,21 @@ MainWindow::MainWindow(QWidget *parent) :
 
     connect(selectInputBtn, &QPushButton::released, this, &MainWindow::onSelectInput);
     connect(runBtn, &QPushButton::released, this, &MainWindow::onRun);
+    connect(cancelBtn, &QPushButton::released, this, &MainWindow::onCancel);
     connect(saveModelBtn, &QPushButton::released, this, &MainWindow::onSaveModel);
     connect(saveResultBtn, &QPushButton::released, this, &MainWindow::onSaveResult);
+    connect(openResultBtn, &QPushButton::released, this, &MainWindow::onOpenResult);
     connect(nextStepBtn, &QPushButton::released, this, &MainWindow::onNextStep);
     connect(prevStepBtn, &QPushButton::released, this, &MainWindow::onPrevStep);
     connect(restartBtn, &QPushButton::released, this, &MainWindow::onRestart);
+    connect(playBtn, &QPushButton::released, this, &MainWindow::onPlay);
+    connect(playTimer, &QTimer::timeout, this, &MainWindow::onPlayTick);
+    connect(fpsInput, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int fps){ playTimer->setInterval(1000 / fps); });
 
     solver = nullptr;
+    solveThread = nullptr;
+    showingTrace = false;
+    currentStep = 0;
 }
 
 void MainWindow::onSelectInput(){
@@ -97,54 +124,153 @@ void MainWindow::onSelectInput(){
 }
 
 void MainWindow::onRun() {
+    if(solveThread != nullptr){
+        if(solveThread->isRunning()){
+            return;
+        }
+        delete solveThread;
+        solveThread = nullptr;
+    }
+    OnePassSynth* next = new OnePassSynth(filepath);
+    if(!next->get_errors().empty()){
+        // keep the previous solution on screen
+        QString msg = QString::fromStdString(next->get_errors().front());
+        if(next->get_errors().size() > 1){
+            msg += QString(" (and %1 more)").arg(next->get_errors().size() - 1);
+        }
+        bar->showMessage(msg);
+        delete next;
+        return;
+    }
     if(solver != nullptr){
+        // solving the same assay again, e.g. with one more step or column, starts from the last solution
+        next->set_hint(*solver);
         delete solver;
     }
-    solver = new OnePassSynth(filepath);
+    solver = next;
+    if(flowDiagramBox->isChecked()){
+        // <input>.dot and <input>.png next to the input file, dot runs while solving
+        solver->print_flow_diagram(filepath);
+    }
 
     int width = widthInput->value();
     int height = heightInput->value();
     int time = timeInput->value();
 
-    bool is_solved = false;
-    for(int t = time/2; t <= time && !is_solved; t++){
-        if(solver->solve(width, height, t)){
-            char msg[100];
-            sprintf(msg, "Sat! w=%d h=%d t=%d. Showing status at t=0", width, height, t);
-            bar->showMessage(msg);
-
-            solver->print_solution();
-            gridData = solver->get_grid();
-            sinkDispData = solver->get_sink_dispenser_pos();
-            detectorData = solver->get_detector_pos();
-
-            is_solved = true;
-            currentStep = 0;
-            paint();
-        }else{
-            char msg[100];
-            sprintf(msg, "Unsat! w=%d h=%d t=%d", width, height, t);
-            bar->showMessage(msg);
-        }
+    // solve off the GUI thread, onProgress() and onSolved() are queued back to it
+    solveThread = new SolveThread(solver, width, height, time, this);
+    connect(solveThread, &SolveThread::progress, this, &MainWindow::onProgress);
+    connect(solveThread, &SolveThread::solved, this, &MainWindow::onSolved);
+
+    runBtn->setEnabled(false);
+    cancelBtn->setEnabled(true);
+    bar->showMessage("Solving...");
+    solveThread->start();
+}
+
+void MainWindow::onCancel() {
+    if(solveThread != nullptr && solveThread->isRunning()){
+        solver->interrupt();
+        bar->showMessage("Cancelling...");
+    }
+}
+
+void MainWindow::onProgress(int width, int height, int time, qint64 ms, bool sat, QString reason) {
+    // a candidate that ran out of time or was cancelled is not unsat
+    QString result = sat ? QString("Sat") : reason.isEmpty() ? QString("Unsat") : "Unknown (" + reason + ")";
+    bar->showMessage(QString("%1 w=%2 h=%3 t=%4 (%5 ms)").arg(result).arg(width).arg(height).arg(time).arg(ms));
+}
+
+void MainWindow::onSolved(bool sat) {
+    runBtn->setEnabled(true);
+    cancelBtn->setEnabled(false);
+
+    if(sat){
+        char msg[100];
+        sprintf(msg, "Sat! w=%d h=%d t=%d. Showing status at t=0", widthInput->value(), heightInput->value(), solver->get_time());
+        bar->showMessage(msg);
+
+        solver->print_solution();
+        stopPlaying();
+        showingTrace = false;
+        traceFile.close();
+        gridData = solver->get_grid();
+        sinkDispData = solver->get_sink_dispenser_pos();
+        detectorData = solver->get_detector_pos();
+
+        currentStep = 0;
+        paint();
+    }else{
+        // candidates that ran out of time were passed over, the grid is not proven unsat then
+        int skipped = solver->get_stats().no_of_skipped();
+        QString result = solver->is_interrupted() ? QString("Cancelled!") : skipped > 0 ? QString("Unknown, %1 candidates skipped!").arg(skipped) : QString("Unsat!");
+        bar->showMessage(QString("%1 w=%2 h=%3 t<=%4").arg(result).arg(widthInput->value()).arg(heightInput->value()).arg(timeInput->value()));
     }
 }
 
 void MainWindow::onSaveModel() {
+    // the worker owns the z3 context while it solves
+    if(solver == nullptr || (solveThread != nullptr && solveThread->isRunning())){
+        return;
+    }
     string savePath = filepath.substr(0, filepath.find_last_of('.')) + "_model.txt";
     cout << "Saving model to: " << savePath << endl;
     solver->get_solver().save_solver(savePath);
 }
 
 void MainWindow::onSaveResult() {
-    string savePath = filepath.substr(0, filepath.find_last_of('.')) + "_result.txt";
+    if(solver == nullptr || (solveThread != nullptr && solveThread->isRunning())){
+        return;
+    }
+    string savePath = filepath.substr(0, filepath.find_last_of('.')) + "_result.trace";
     cout << "Saving result to: " << savePath << endl;
-    solver->get_solver().save_solver(savePath);
+    string msg = solver->save_trace(savePath) ? "Result saved to " + savePath : "No result to save";
+    bar->showMessage(msg.c_str());
+}
+
+void MainWindow::onOpenResult() {
+    QString path = QFileDialog::getOpenFileName(this, "Open Result", ".", "Solution traces (*.trace);;All files (*)");
+    if(path.isEmpty()){
+        return;
+    }
+    // frames are decoded from the mapping as they are shown, nothing is solved
+    stopPlaying();
+    showingTrace = false;
+    traceFile.close();
+    traceFile.setFileName(path);
+    uchar* data = nullptr;
+    if(traceFile.open(QIODevice::ReadOnly)){
+        data = traceFile.map(0, traceFile.size());
+    }
+    if(data == nullptr){
+        bar->showMessage("Cannot read " + path);
+        traceFile.close();
+        return;
+    }
+    if(!trace.open(data, traceFile.size())){
+        bar->showMessage(path + ": " + QString::fromStdString(trace.get_error()));
+        traceFile.close();
+        return;
+    }
+
+    showingTrace = true;
+    sinkDispData = trace.get_sink_dispenser_pos();
+    detectorData = trace.get_detector_pos();
+    currentStep = 0;
+    if(!paint()){
+        return;
+    }
+    char msg[100];
+    sprintf(msg, "Result w=%d h=%d t=%d. Showing status at t=0", trace.get_width(), trace.get_height(), trace.get_frames() - 1);
+    bar->showMessage(msg);
 }
 
 void MainWindow::onNextStep() {
-    if(currentStep < gridData.size()-1)
+    if(currentStep + 1 < stepCount())
         currentStep++;
-    paint();
+    if(!paint()){
+        return;
+    }
     char msg[50];
     sprintf(msg, "Currently showing t=%d", currentStep);
     bar->showMessage(msg);
@@ -153,7 +279,9 @@ void MainWindow::onNextStep() {
 void MainWindow::onPrevStep() {
     if(currentStep > 0)
         currentStep--;
-    paint();
+    if(!paint()){
+        return;
+    }
     char msg[50];
     sprintf(msg, "Currently showing t=%d", currentStep);
     bar->showMessage(msg);
@@ -161,23 +289,69 @@ void MainWindow::onPrevStep() {
 
 void MainWindow::onRestart() {
     currentStep = 0;
-    paint();
+    if(!paint()){
+        return;
+    }
     char msg[50];
     sprintf(msg, "Currently showing t=%d", currentStep);
     bar->showMessage(msg);
 }
 
-void MainWindow::paint(){
-    render->gridData = gridData[currentStep];
-    if(currentStep == 0){
-        render->sinkDispData = sinkDispData;
-        render->detectorData = detectorData;
+void MainWindow::onPlay() {
+    if(playTimer->isActive()){
+        stopPlaying();
+        return;
+    }
+    if(stepCount() == 0){
+        return;
+    }
+    if(currentStep + 1 >= stepCount()){
+        onRestart();
     }
+    playBtn->setText("Pause");
+    playTimer->start(1000 / fpsInput->value());
+}
+
+void MainWindow::onPlayTick() {
+    if(currentStep + 1 >= stepCount()){
+        stopPlaying();
+        return;
+    }
+    onNextStep();
+}
+
+void MainWindow::stopPlaying() {
+    playTimer->stop();
+    playBtn->setText("Play");
+}
 
-    render->do_update();
+bool MainWindow::paint(){
+    if(stepCount() == 0){
+        return true;
+    }
+    if(currentStep == 0){
+        render->setPlacements(sinkDispData, detectorData);
+    }
+    // RenderArea repaints the cells that changed since the step on screen
+    if(showingTrace){
+        // open() only checks that the frames are there, a corrupt delta shows up here
+        if(!trace.frame(currentStep, traceFrame)){
+            stopPlaying();
+            bar->showMessage(QString("Cannot show t=%1: %2").arg(currentStep).arg(QString::fromStdString(trace.get_error())));
+            return false;
+        }
+        render->setFrame(traceFrame);
+    }else{
+        render->setFrame(gridData[currentStep]);
+    }
+    return true;
 }
 
 MainWindow::~MainWindow()
 {
+    if(solveThread != nullptr && solveThread->isRunning()){
+        solver->interrupt();
+        solveThread->wait();
+    }
     delete ui;
 }
@@ -3,6 +3,8 @@
 #include <QPainter>
 #include <string>
 #include <cstdio>
+#include <vector>
+#include <algorithm>
 
 using namespace std;
 
@@ -26,6 +28,48 @@ RenderArea::RenderArea(QWidget *parent)
     mixing_src = QRect(0, 0, 225, 225);
     empty_img.load((string("") + PATH_TO_RES + EMPTY_IMG).c_str());
     empty_src = QRect(0, 0, 225, 225);
+    spriteSize = 0;
+}
+
+void RenderArea::scaleSprites(int D)
+{
+    auto scaled = [D](const QImage& img, const QRect& src){
+        return QPixmap::fromImage(img.copy(src).scaled(D, D, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    };
+    droplet_pix = scaled(droplet_img, droplet_src);
+    detector_pix = scaled(detector_img, detector_src);
+    detecting_pix = scaled(detecting_img, detecting_src);
+    dispenser_pix = scaled(dispenser_img, dispenser_src);
+    sink_pix = scaled(sink_img, sink_src);
+    mixing_pix = scaled(mixing_img, mixing_src);
+    empty_pix = scaled(empty_img, empty_src);
+    spriteSize = D;
+}
+
+void RenderArea::setPlacements(const vector<Node>& sinkDisp, const vector<vector<pair<bool, string>>>& detectors)
+{
+    sinkDispData = sinkDisp;
+    detectorData = detectors;
+    update();
+}
+
+void RenderArea::setFrame(const vector<vector<int>>& grid)
+{
+    bool sameShape = grid.size() == gridData.size() && (grid.empty() || grid[0].size() == gridData[0].size());
+    if(!sameShape){
+        gridData = grid;
+        update();
+        return;
+    }
+    int D = cellSize();
+    for(int y = 0; y < grid.size(); y++){
+        for(int x = 0; x < grid[y].size(); x++){
+            if(grid[y][x] != gridData[y][x]){
+                gridData[y][x] = grid[y][x];
+                update((x+1)*D, (y+1)*D, D, D);
+            }
+        }
+    }
 }
 
 QSize RenderArea::minimumSizeHint() const
@@ -57,7 +101,7 @@ void getPos(int& x, int& y, int w, int m, int n, int z){
     }
 }
 
-void RenderArea::paintEvent(QPaintEvent * /* event */)
+void RenderArea::paintEvent(QPaintEvent *event)
 {
     QPainter painter(this);
 
@@ -65,45 +109,51 @@ void RenderArea::paintEvent(QPaintEvent * /* event */)
         return;
     }
 
-    int D = width() / (gridData.size()+2);
+    int D = cellSize();
+    if(D <= 0){
+        return;
+    }
+    if(D != spriteSize){
+        scaleSprites(D);
+    }
     int w = gridData[0].size();
     int h = gridData.size();
+    // only what setFrame() marked, or everything after a resize or setPlacements()
+    QRect dirty = event->rect();
+
     for(int p = 0; p < sinkDispData.size(); p++){
         int x, y;
         getPos(x, y, D, w, h, p);
         QRect target(x, y, D, D);
+        if(!target.intersects(dirty))
+            continue;
         if(sinkDispData[p].type_ == 1)
-            painter.drawImage(target, sink_img, sink_src);
+            painter.drawPixmap(x, y, sink_pix);
         else if(sinkDispData[p].type_ == 2)
-            painter.drawImage(target, dispenser_img, dispenser_src);
+            painter.drawPixmap(x, y, dispenser_pix);
     }
 
-    for(int y = 0; y < detectorData.size(); y++){
-        for(int x = 0; x < detectorData.size(); x++){
-            if(detectorData[y][x].first && !(gridData[y][x]==-1)){
-                QRect target((x+1)*D, (y+1)*D, D, D);
-                painter.drawImage(target, detector_img, detector_src);
+    int xFrom = max(0, dirty.left() / D - 1), xTo = min(w - 1, dirty.right() / D - 1);
+    int yFrom = max(0, dirty.top() / D - 1), yTo = min(h - 1, dirty.bottom() / D - 1);
+    for(int y = yFrom; y <= yTo; y++){
+        for(int x = xFrom; x <= xTo; x++){
+            int v = gridData[y][x];
+            bool detector = y < detectorData.size() && x < detectorData[y].size() && detectorData[y][x].first;
+            QRect target((x+1)*D, (y+1)*D, D, D);
+            if(detector && v != -1){
+                painter.drawPixmap(target.topLeft(), detector_pix);
             }
-        }
-    }
-
-    for(int y = 0; y < gridData.size(); y++){
-        for(int x = 0; x < gridData[y].size(); x++){
-            if(gridData[y][x] == -2){ // mixing
-                QRect target((x+1)*D, (y+1)*D, D, D);
-                painter.drawImage(target, mixing_img, mixing_src);
-            }else if(gridData[y][x] == -1){ // detecting
-                QRect target((x+1)*D, (y+1)*D, D, D);
-                painter.drawImage(target, detecting_img, detecting_src);
-            }else if(gridData[y][x] >= 0){
-                QRect target((x+1)*D, (y+1)*D, D, D);
-                painter.drawImage(target, droplet_img, droplet_src);
+            if(v == -2){ // mixing
+                painter.drawPixmap(target.topLeft(), mixing_pix);
+            }else if(v == -1){ // detecting
+                painter.drawPixmap(target.topLeft(), detecting_pix);
+            }else if(v >= 0){
+                painter.drawPixmap(target.topLeft(), droplet_pix);
                 char id[10];
-                sprintf(id, "%d", gridData[y][x]);
+                sprintf(id, "%d", v);
                 painter.drawText(target, Qt::AlignCenter, id);
-            }else if(!detectorData[y][x].first){
-                QRect target((x+1)*D, (y+1)*D, D, D);
-                painter.drawImage(target, empty_img, empty_src);
+            }else if(!detector){
+                painter.drawPixmap(target.topLeft(), empty_pix);
             }
         }
     }
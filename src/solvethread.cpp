@@ -0,0 +1,17 @@
+#include "solvethread.h"
+
+SolveThread::SolveThread(OnePassSynth *solver, int width, int height, int time, QObject *parent)
+    : QThread(parent), solver(solver), width(width), height(height), time(time)
+{
+}
+
+void SolveThread::run()
+{
+    solver->set_progress_callback([this](int w, int h, int t, long long ms, bool sat, const std::string& reason){
+        emit progress(w, h, t, ms, sat, QString::fromStdString(reason));
+    });
+    bool sat = solver->solve_min_time(width, height, 1, time);
+    // the solver outlives this thread, its solution seeds the next run
+    solver->set_progress_callback(ProgressCallback());
+    emit solved(sat);
+}
@@ -0,0 +1,45 @@
+#-------------------------------------------------
+#
+# Unit tests, no Qt needed at run time.
+# Run "./tests ../testcase" from the build directory, with test names to run only those
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = tests
+TEMPLATE = app
+
+CONFIG += console c++11 thread
+CONFIG -= app_bundle qt
+INCLUDEPATH += . ./include ./tests
+LIBS += -lz3
+
+# app.pro builds the same sources with its own flags
+OBJECTS_DIR = build-tests
+
+SOURCES += \
+        tests/main.cc \
+        tests/test_layout.cc \
+        tests/test_encoding.cc \
+        tests/test_parser.cc \
+        tests/test_cache.cc \
+        tests/test_trace.cc \
+        tests/test_driver_util.cc \
+        tests/test_stats.cc \
+        tests/test_decompose.cc \
+        tests/test_min_time.cc \
+        Architecture.cc \
+        Solver.cc \
+        SolutionCache.cc \
+        SolutionTrace.cc \
+        DriverUtil.cc
+
+HEADERS += \
+        tests/test.h \
+        include/Architecture.h \
+        include/Module.h \
+        include/Solver.h \
+        include/SolutionCache.h \
+        include/SolutionTrace.h \
+        include/DriverUtil.h
@@ -0,0 +1,74 @@
+#include "test.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+static int failures = 0;
+static string dir = "../testcase";
+static string scratch;
+
+vector<TestCase>& test_cases(){
+    static vector<TestCase> cases;
+    return cases;
+}
+
+void test_failed(const char* file, int line, const string& what){
+    cerr << file << ":" << line << ": failed: " << what << endl;
+    failures++;
+}
+
+const string& testcase_dir(){
+    return dir;
+}
+
+string scratch_path(const string& name){
+    if(scratch.empty()){
+        char tmpl[] = "/tmp/oops-tests-XXXXXX";
+        if(mkdtemp(tmpl) == nullptr){
+            cerr << "cannot create a scratch directory" << endl;
+            exit(2);
+        }
+        scratch = tmpl;
+    }
+    return scratch + "/" + name;
+}
+
+// ./tests [testcase dir] [test name]...
+int main(int argc, char* argv[]){
+    vector<string> only;
+    for(int i = 1; i < argc; i++){
+        if(i == 1 && strchr(argv[i], '/') != nullptr){
+            dir = argv[i];
+        }else{
+            only.push_back(argv[i]);
+        }
+    }
+    int ran = 0, failed = 0;
+    for(auto& tc: test_cases()){
+        bool selected = only.empty();
+        for(auto& name: only){
+            selected = selected || name == tc.name_;
+        }
+        if(!selected){
+            continue;
+        }
+        int before = failures;
+        tc.run_();
+        ran++;
+        bool ok = failures == before;
+        failed += !ok;
+        cout << (ok ? "ok   " : "FAIL ") << tc.name_ << endl;
+    }
+    if(!scratch.empty()){
+        string cmd = "rm -rf '" + scratch + "'";
+        if(system(cmd.c_str()) != 0){
+            cerr << "cannot remove " << scratch << endl;
+        }
+    }
+    cout << ran - failed << "/" << ran << " tests passed" << endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+
+// TEST(name) { ... } defines a test, main() runs them in the order they are linked.
+// CHECK records a failure and goes on, REQUIRE also ends the test
+struct TestCase {
+    const char* name_;
+    void (*run_)();
+};
+std::vector<TestCase>& test_cases();
+
+struct TestRegistrar {
+    TestRegistrar(const char* name, void (*run)()) { test_cases().push_back(TestCase{name, run}); }
+};
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistrar name##_registrar(#name, name); \
+    static void name()
+
+void test_failed(const char* file, int line, const std::string& what);
+
+#define CHECK(cond) do { if(!(cond)) test_failed(__FILE__, __LINE__, #cond); } while(0)
+#define REQUIRE(cond) do { if(!(cond)) { test_failed(__FILE__, __LINE__, #cond); return; } } while(0)
+#define CHECK_EQ(a, b) do { \
+        if(!((a) == (b))) { \
+            std::ostringstream msg_; \
+            msg_ << #a " == " #b ", got " << (a) << " and " << (b); \
+            test_failed(__FILE__, __LINE__, msg_.str()); \
+        } \
+    } while(0)
+
+// directory with the shipped assays, the first argument of the test driver
+const std::string& testcase_dir();
+// a file in a scratch directory of this run, removed with it at the end
+std::string scratch_path(const std::string& name);
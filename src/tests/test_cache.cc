@@ -0,0 +1,54 @@
+#include "test.h"
+#include "OnePassSynth.h"
+
+#include <sys/stat.h>
+
+using namespace std;
+
+// Solver leaves creating the directory to its caller, as synth does
+static SolverOptions cached_in(const string& dir){
+    mkdir(dir.c_str(), 0755);
+    SolverOptions options;
+    options.cache_dir_ = dir;
+    return options;
+}
+
+TEST(cache_serves_earlier_verdicts){
+    string dir = scratch_path("cache");
+    string assay = testcase_dir() + "/2_mix.txt";
+    {
+        OnePassSynth first(assay);
+        first.set_options(cached_in(dir));
+        CHECK(first.solve(3, 3, 5));
+        CHECK(!first.solve(3, 3, 3));
+    }
+    OnePassSynth again(assay);
+    again.set_options(cached_in(dir));
+    CHECK(again.solve(3, 3, 5));
+    CHECK_EQ(again.get_grid().size(), 6u);
+    CHECK(!again.solve(3, 3, 3));
+    // both came from the cache, nothing was encoded
+    CHECK_EQ(again.get_solver().get_solver().assertions().size(), 0u);
+}
+
+TEST(cache_leaves_out_hinted_solutions){
+    string dir = scratch_path("hinted-cache");
+    string assay = testcase_dir() + "/2_mix.txt";
+    OnePassSynth previous(assay);
+    REQUIRE(previous.solve(3, 3, 5));
+    {
+        OnePassSynth hinted(assay);
+        hinted.set_options(cached_in(dir));
+        REQUIRE(hinted.set_hint(previous));
+        CHECK(hinted.solve(3, 3, 6));
+        CHECK(!hinted.solve(3, 3, 3));
+    }
+    // the unsat verdict holds without the hint, the solution is only the best one close to it
+    OnePassSynth plain(assay);
+    plain.set_options(cached_in(dir));
+    CHECK(plain.solve(3, 3, 6));
+    CHECK(!plain.solve(3, 3, 3));
+    REQUIRE(plain.get_stats().checks_.size() == 2);
+    CHECK(!plain.get_stats().checks_[0].cached_);
+    CHECK(plain.get_stats().checks_[1].cached_);
+}
@@ -0,0 +1,56 @@
+#include "test.h"
+#include "OnePassSynth.h"
+
+#include <string>
+
+using namespace std;
+
+// 8_complex and 9_PCR take minutes in one pass
+static const char* small[] = {
+    "1_dispense_output.txt", "2_mix.txt", "3_detect.txt", "4_mix_detect.txt", "5_multiple_dispense.txt",
+    "6_multiple_output.txt", "7_multiple_mix_output.txt"
+};
+
+static SolverOptions decomposed(){
+    SolverOptions options;
+    options.decompose_ = true;
+    return options;
+}
+
+TEST(decompose_agrees_with_one_pass){
+    for(auto name: small){
+        string assay = testcase_dir() + "/" + name;
+        OnePassSynth exact(assay);
+        OnePassSynth heuristic(assay);
+        heuristic.set_options(decomposed());
+        bool is_sat = exact.solve();
+        CHECK_EQ(heuristic.solve(), is_sat);
+        if(is_sat){
+            // no smaller grid, the horizon within the limit but maybe longer
+            Solver& a = exact.get_solver();
+            Solver& b = heuristic.get_solver();
+            CHECK_EQ(b.get_width() * b.get_height(), a.get_width() * a.get_height());
+            CHECK(b.get_time() >= a.get_time());
+            CHECK(b.get_time() <= a.get_time_limit());
+        }
+    }
+}
+
+TEST(decompose_falls_back_to_one_pass){
+    // 5 steps at least, no schedule fits 4 and the one-pass search proves it unsat (by the
+    // lower bound of the DAG here), nothing is left unknown
+    OnePassSynth tight(testcase_dir() + "/2_mix.txt");
+    tight.set_options(decomposed());
+    CHECK(!tight.get_solver().solve_decomposed(3, 3, 4));
+    const SolverStats& stats = tight.get_stats();
+    CHECK_EQ(stats.no_of_skipped(), 0);
+    for(auto& cs: stats.checks_){
+        CHECK_EQ(cs.result_, "unsat");
+    }
+
+    // the tightest schedule fits the optimum exactly
+    OnePassSynth exact(testcase_dir() + "/2_mix.txt");
+    exact.set_options(decomposed());
+    CHECK(exact.get_solver().solve_decomposed(3, 3, 5));
+    CHECK_EQ(exact.get_time(), 5);
+}
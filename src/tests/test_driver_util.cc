@@ -0,0 +1,90 @@
+#include "test.h"
+#include "DriverUtil.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// argv as the drivers get it, argv[0] is the program
+struct Args {
+    vector<string> strings_;
+    vector<char*> argv_;
+
+    Args(const vector<string>& args): strings_(args) {
+        strings_.insert(strings_.begin(), "prog");
+        for(auto& s: strings_){
+            argv_.push_back(&s[0]);
+        }
+    }
+    int argc() { return argv_.size(); }
+    char** argv() { return argv_.data(); }
+};
+
+TEST(driver_parses_numbers){
+    int value = 7;
+    CHECK(parse_int("42", value));
+    CHECK_EQ(value, 42);
+    CHECK(parse_int("-3", value));
+    CHECK_EQ(value, -3);
+    CHECK(!parse_int("", value));
+    CHECK(!parse_int("4x", value));
+    CHECK(!parse_int("x", value));
+}
+
+TEST(driver_parses_solver_options){
+    Args args({"--backend", "sat", "--objective", "staged", "--stage-budget", "250", "--symmetry",
+               "--sparse-actions", "--check-timeout", "-5", "--decompose", "--window", "8", "--overlap", "2", "-w", "4"});
+    SolverOptions opts;
+    vector<int> results;
+    for(int i = 1; i < args.argc(); i++){
+        results.push_back(parse_solver_option(args.argc(), args.argv(), i, opts));
+        if(results.back() == 0){
+            i++; // -w and its value are the driver's own
+        }
+    }
+    CHECK(results == vector<int>({1, 1, 1, 1, 1, 1, 1, 1, 1, 0}));
+    CHECK_EQ(opts.backend_, SAT);
+    CHECK_EQ(opts.objective_, STAGED);
+    CHECK_EQ(opts.stage_budget_ms_, 250);
+    CHECK(opts.symmetry_breaking_);
+    CHECK(opts.sparse_actions_);
+    CHECK_EQ(opts.check_timeout_ms_, 0u);
+    CHECK(opts.decompose_);
+    CHECK_EQ(opts.window_, 8);
+    CHECK_EQ(opts.window_overlap_, 2);
+}
+
+TEST(driver_rejects_bad_solver_options){
+    SolverOptions opts;
+    const char* bad[][2] = {{"--backend", "smt"}, {"--objective", "fast"}, {"--retries", "two"}};
+    for(auto& pair: bad){
+        Args args({pair[0], pair[1]});
+        int i = 1;
+        CHECK_EQ(parse_solver_option(args.argc(), args.argv(), i, opts), -1);
+    }
+    // without its value it is not taken, the driver reports it as unknown
+    Args missing({"--backend"});
+    int i = 1;
+    CHECK_EQ(parse_solver_option(missing.argc(), missing.argv(), i, opts), 0);
+    CHECK_EQ(opts.backend_, OPTIMIZE);
+}
+
+TEST(driver_expands_directories){
+    vector<string> files;
+    REQUIRE(expand_inputs(vector<string>{testcase_dir(), testcase_dir() + "/2_mix.txt"}, files));
+    REQUIRE(files.size() >= 10);
+    CHECK_EQ(files.front(), testcase_dir() + "/1_dispense_output.txt");
+    CHECK_EQ(files.back(), testcase_dir() + "/2_mix.txt");
+    for(size_t k = 0; k + 1 < files.size(); k++){
+        CHECK(files[k].find(".dot") == string::npos && files[k].find(".png") == string::npos);
+    }
+    vector<string> none;
+    CHECK(!expand_inputs(vector<string>{testcase_dir() + "/no_such_file.txt"}, none));
+}
+
+TEST(json_strings_are_escaped){
+    CHECK_EQ(json_string("plain"), "\"plain\"");
+    CHECK_EQ(json_string("a \"b\" \\c"), "\"a \\\"b\\\" \\\\c\"");
+    CHECK_EQ(json_string("line\nend"), "\"line\\u000aend\"");
+}
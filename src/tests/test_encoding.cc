@@ -0,0 +1,54 @@
+#include "test.h"
+#include "OnePassSynth.h"
+
+#include <string>
+
+using namespace std;
+
+// smallest sat horizon of each assay, the same on 3x3, 4x3, 3x4 and 4x4 as the first
+// implementation finds it, building a new encoding for every candidate
+static const pair<const char*, int> boundaries[] = {
+    {"1_dispense_output.txt", 2}, {"2_mix.txt", 5}, {"3_detect.txt", 5}, {"4_mix_detect.txt", 9},
+    {"5_multiple_dispense.txt", 8}, {"6_multiple_output.txt", 3}, {"7_multiple_mix_output.txt", 9}
+};
+static const int grids[][2] = {{3, 3}, {4, 3}, {3, 4}, {4, 4}};
+
+// one horizon short of the boundary is unsat, the boundary itself sat
+static void check_boundaries(const SolverOptions& options, const string& what){
+    for(auto& b: boundaries){
+        for(auto& g: grids){
+            OnePassSynth synth(testcase_dir() + "/" + b.first);
+            synth.set_options(options);
+            bool short_sat = synth.solve(g[0], g[1], b.second - 1);
+            bool sat = synth.solve(g[0], g[1], b.second);
+            if(short_sat || !sat){
+                test_failed(__FILE__, __LINE__, what + ": " + b.first + " " + to_string(g[0]) + "x" + to_string(g[1])
+                    + " t=" + to_string(b.second - 1) + (short_sat ? " sat" : " unsat") + ", t=" + to_string(b.second) + (sat ? " sat" : " unsat"));
+            }
+        }
+    }
+}
+
+TEST(encoding_keeps_boundaries_with_optimize){
+    check_boundaries(SolverOptions(), "optimize");
+}
+
+TEST(encoding_keeps_boundaries_with_sparse_actions){
+    SolverOptions options;
+    options.sparse_actions_ = true;
+    check_boundaries(options, "sparse actions");
+}
+
+TEST(encoding_keeps_boundaries_with_sat){
+    SolverOptions options;
+    options.backend_ = SAT;
+    check_boundaries(options, "sat");
+}
+
+TEST(encoding_keeps_boundaries_with_symmetry_breaking){
+    SolverOptions options;
+    options.symmetry_breaking_ = true;
+    check_boundaries(options, "optimize, symmetry breaking");
+    options.backend_ = SAT;
+    check_boundaries(options, "sat, symmetry breaking");
+}
@@ -0,0 +1,63 @@
+#include "test.h"
+#include "OnePassSynth.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+TEST(perimeter_corner_has_two_slots){
+    // (W-1, 0) of a 4 x 3 grid: its top side and its right side
+    CHECK_EQ(Solver::perimeter_pos(4, 3, 3, 0, 0), 3);
+    CHECK_EQ(Solver::perimeter_pos(4, 3, 3, 0, 1), 4);
+}
+
+TEST(perimeter_slots_are_one_to_one){
+    for(int w = 1; w <= 5; w++){
+        for(int h = 1; h <= 5; h++){
+            vector<int> hits(2*w + 2*h, 0);
+            for(int x = 0; x < w; x++){
+                hits[Solver::perimeter_pos(w, h, x, 0, 0)]++;
+                hits[Solver::perimeter_pos(w, h, x, h-1, 2)]++;
+            }
+            for(int y = 0; y < h; y++){
+                hits[Solver::perimeter_pos(w, h, w-1, y, 1)]++;
+                hits[Solver::perimeter_pos(w, h, 0, y, 3)]++;
+            }
+            for(size_t p = 0; p < hits.size(); p++){
+                if(hits[p] != 1){
+                    test_failed(__FILE__, __LINE__, to_string(w) + "x" + to_string(h) + " slot " + to_string(p)
+                        + " taken " + to_string(hits[p]) + " times");
+                }
+            }
+        }
+    }
+}
+
+// 2_mix with a mixer of mixer_w x mixer_h
+static string mix_assay(int mixer_w, int mixer_h){
+    string filename = scratch_path("mix_" + to_string(mixer_w) + "x" + to_string(mixer_h) + ".txt");
+    ofstream out(filename);
+    out << "DAGNAME (Tiny Dag)\n"
+        << "NODE (1, DISPENSE, tris-hcl, 10, DIS1)\n"
+        << "NODE (2, DISPENSE, kcl, 10, DIS2)\n"
+        << "NODE (3, MIX, 3, 2, MIX1)\n"
+        << "NODE (4, OUTPUT, output, OUT1)\n"
+        << "EDGE (1, 3)\nEDGE (2, 3)\nEDGE (3, 4)\n"
+        << "TIME (5)\nSIZE (3, 3)\n"
+        << "MOD  (MIX1, " << mixer_w << ", " << mixer_h << ")\n"
+        << "MOD  (DIS1, 1)\nMOD  (DIS2, 1)\nMOD  (OUT1, 1)\n";
+    return filename;
+}
+
+TEST(mixer_footprint_must_fit_the_grid){
+    // the output cell of a 4 x 2 mixer fits a 3 x 3 grid, the rest of it does not
+    OnePassSynth narrow(mix_assay(4, 2));
+    CHECK(!narrow.solve(3, 3, 12));
+    OnePassSynth wide(mix_assay(4, 2));
+    CHECK(wide.solve(4, 3, 12));
+    // one that fills the grid exactly
+    OnePassSynth full(mix_assay(3, 3));
+    CHECK(full.solve(3, 3, 12));
+}
@@ -0,0 +1,58 @@
+#include "test.h"
+#include "OnePassSynth.h"
+
+using namespace std;
+
+// the optimum of 5_multiple_dispense on 3x3 is 8: the gallop checks 2, 4 and 8, the bisection 6 and 7
+static const char* BISECTED = "/5_multiple_dispense.txt";
+
+TEST(min_time_agrees_with_a_linear_search){
+    for(Backend backend: {OPTIMIZE, SAT}){
+        SolverOptions options;
+        options.backend_ = backend;
+        OnePassSynth linear(testcase_dir() + BISECTED);
+        linear.set_options(options);
+        int time = 1;
+        while(time <= 20 && !linear.solve(3, 3, time)){
+            time++;
+        }
+        OnePassSynth synth(testcase_dir() + BISECTED);
+        synth.set_options(options);
+        REQUIRE(synth.solve_min_time(3, 3, 1, 20));
+        CHECK_EQ(synth.get_time(), time);
+        // the solution of the optimum, not one of the longer horizon the gallop stopped at
+        CHECK_EQ(synth.get_grid().size(), (size_t)time + 1);
+    }
+}
+
+TEST(min_time_builds_the_grid_once){
+    OnePassSynth synth(testcase_dir() + BISECTED);
+    REQUIRE(synth.solve_min_time(3, 3, 1, 20));
+    const SolverStats& stats = synth.get_stats();
+    // some probe went below a sat horizon
+    bool below_sat = false;
+    int sat_time = -1;
+    for(auto& cs: stats.checks_){
+        if(sat_time >= 0 && cs.time_ < sat_time){
+            below_sat = true;
+        }
+        if(cs.result_ == "sat"){
+            sat_time = cs.time_;
+        }
+    }
+    CHECK(below_sat);
+
+    // init() alone adds the placement constraints
+    OnePassSynth once(testcase_dir() + BISECTED);
+    REQUIRE(once.solve(3, 3, synth.get_time()));
+    CHECK_EQ(stats.phases_[PHASE_PLACEMENT].assertions_, once.get_stats().phases_[PHASE_PLACEMENT].assertions_);
+
+    // the optimum is kept from its own probe, not checked again
+    int optimum_checks = 0;
+    for(auto& cs: stats.checks_){
+        if(cs.time_ == synth.get_time()){
+            optimum_checks++;
+        }
+    }
+    CHECK_EQ(optimum_checks, 1);
+}
@@ -0,0 +1,180 @@
+#include "test.h"
+#include "Architecture.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char* shipped[] = {
+    "1_dispense_output.txt", "2_mix.txt", "3_detect.txt", "4_mix_detect.txt", "5_multiple_dispense.txt",
+    "6_multiple_output.txt", "7_multiple_mix_output.txt", "8_complex.txt", "9_PCR.txt"
+};
+
+// 2_mix, errors are reported against "a.txt"
+static const char* tiny =
+    "DAGNAME (Tiny)\n"
+    "NODE (1, DISPENSE, tris-hcl, 10, DIS1)\n"
+    "NODE (2, DISPENSE, kcl, 10, DIS2)\n"
+    "NODE (3, MIX, 3, 2, MIX1)\n"
+    "NODE (4, OUTPUT, output, OUT1)\n"
+    "EDGE (1, 3)\n"
+    "EDGE (2, 3)\n"
+    "EDGE (3, 4)\n"
+    "TIME (5)\n"
+    "SIZE (3, 3)\n"
+    "MOD (MIX1, 2, 2)\n"
+    "MOD (DIS1, 1)\n"
+    "MOD (DIS2, 1)\n"
+    "MOD (OUT1, 1)\n";
+
+// tiny with text as its line number line, replacing that line or after the last one
+static string with_line(int line, const string& text){
+    string res;
+    int n = 1;
+    for(const char* p = tiny; *p; p++){
+        if(n != line){
+            res += *p;
+        }else if(*p == '\n'){
+            res += text + "\n";
+        }
+        n += *p == '\n';
+    }
+    if(line >= n){
+        res += text + "\n";
+    }
+    return res;
+}
+
+// text read from the scratch file name, its errors start with name like those of a file in the current directory
+static bool build(Architecture& arch, const string& name, const string& text){
+    string filename = scratch_path(name);
+    ofstream(filename) << text;
+    bool ok = arch.build_from_file(filename);
+    for(auto& error: arch.errors_){
+        if(error.compare(0, filename.size(), filename) == 0){
+            error = name + error.substr(filename.size());
+        }
+    }
+    return ok;
+}
+
+// the parts of an assay the solver reads
+static bool same_assay(Architecture& a, Architecture& b){
+    if(a.label_ != b.label_ || a.edges_ != b.edges_ || a.nodes_.size() != b.nodes_.size() || a.modules_.size() != b.modules_.size()
+        || a.width_limit_ != b.width_limit_ || a.height_limit_ != b.height_limit_ || a.time_limit_ != b.time_limit_){
+        return false;
+    }
+    for(size_t i = 0; i < a.nodes_.size(); i++){
+        Module &m = a.nodes_[i], &n = b.nodes_[i];
+        if(m.type_ != n.type_ || m.label_ != n.label_ || m.time_ != n.time_ || m.drops_ != n.drops_){
+            return false;
+        }
+    }
+    for(auto& module: a.modules_){
+        Module& other = b.modules_[module.first];
+        if(module.second.type_ != other.type_ || module.second.w != other.w || module.second.h != other.h
+            || module.second.desired_amount_ != other.desired_amount_){
+            return false;
+        }
+    }
+    return true;
+}
+
+static vector<string> errors_of(const string& text){
+    Architecture arch;
+    bool ok = build(arch, "a.txt", text);
+    CHECK_EQ(ok, arch.errors_.empty());
+    return arch.errors_;
+}
+
+TEST(parser_reads_shipped_testcases){
+    for(auto name: shipped){
+        Architecture arch;
+        bool ok = arch.build_from_file(testcase_dir() + "/" + name);
+        CHECK(ok);
+        CHECK(arch.errors_.empty());
+        CHECK(!arch.nodes_.empty());
+        CHECK_EQ(arch.forward_edges_.size(), arch.nodes_.size());
+        CHECK(arch.width_limit_ > 0 && arch.height_limit_ > 0 && arch.time_limit_ > 0);
+    }
+}
+
+TEST(parser_reads_2_mix){
+    Architecture arch;
+    REQUIRE(build(arch, "a.txt", tiny));
+    CHECK_EQ(arch.label_, "Tiny");
+    REQUIRE(arch.nodes_.size() == 4);
+    CHECK_EQ(arch.nodes_[2].type_, MIXER);
+    CHECK_EQ(arch.nodes_[2].time_, 2);
+    CHECK_EQ(arch.modules_["MIX1"].w, 2);
+    CHECK_EQ(arch.modules_["MIX1"].h, 2);
+    REQUIRE(arch.edges_.size() == 3);
+    CHECK(arch.edges_[2] == make_pair(2, 3));
+    CHECK_EQ(arch.time_limit_, 5);
+    CHECK_EQ(arch.width_limit_, 3);
+    CHECK_EQ(arch.earliest_.size(), 3u);
+}
+
+TEST(parser_ignores_comments_and_layout){
+    Architecture a, b;
+    REQUIRE(build(a, "a.txt", tiny));
+    REQUIRE(build(b, "b.txt", "// comment\n" + with_line(4, "NODE(3,MIX,  3,2,MIX1) // trailing")));
+    CHECK(same_assay(a, b));
+}
+
+TEST(parser_reports_unknown_module_type){
+    vector<string> errors = errors_of(with_line(15, "NODE (5, HEAT, 3, 2, H1)"));
+    REQUIRE(!errors.empty());
+    CHECK_EQ(errors[0], "a.txt:15:10: module type 'HEAT' not yet supported");
+}
+
+TEST(parser_reports_edge_to_undefined_node){
+    vector<string> errors = errors_of(with_line(15, "EDGE (3, 7)"));
+    REQUIRE(errors.size() == 1);
+    CHECK_EQ(errors[0], "a.txt:15:10: edge to undefined node 7");
+    errors = errors_of(with_line(15, "EDGE (0, 3)"));
+    REQUIRE(errors.size() == 1);
+    CHECK_EQ(errors[0], "a.txt:15:7: edge from undefined node 0");
+}
+
+TEST(parser_reports_malformed_number){
+    vector<string> errors = errors_of(with_line(15, "TIME (5x)"));
+    REQUIRE(errors.size() == 1);
+    CHECK_EQ(errors[0], "a.txt:15:7: expected a number, got '5x'");
+}
+
+TEST(parser_reports_malformed_statements){
+    CHECK_EQ(errors_of(with_line(15, "TIME (5"))[0], "a.txt:15:8: missing ')'");
+    CHECK_EQ(errors_of(with_line(15, "TIME 5"))[0], "a.txt:15:6: expected '(' after TIME");
+    CHECK_EQ(errors_of(with_line(15, "TIME (5, 6)"))[0], "a.txt:15:1: TIME takes 1 parameters, got 2");
+    CHECK_EQ(errors_of(with_line(15, "SPEED (5)"))[0], "a.txt:15:1: unknown statement 'SPEED'");
+    CHECK_EQ(errors_of(with_line(15, "MOD (MIX9, 2, 2)"))[0], "a.txt:15:6: unknown module 'MIX9'");
+}
+
+TEST(parser_reports_every_broken_line){
+    vector<string> errors = errors_of(with_line(15, "TIME (x)") + "SIZE (y, 3)\n");
+    REQUIRE(errors.size() == 2);
+    CHECK_EQ(errors[0], "a.txt:15:7: expected a number, got 'x'");
+    CHECK_EQ(errors[1], "a.txt:16:7: expected a number, got 'y'");
+}
+
+TEST(parser_reports_inconsistent_graphs){
+    auto first_error = [](const string& text){
+        vector<string> errors = errors_of(text);
+        return errors.empty() ? string("no error") : errors[0];
+    };
+    CHECK_EQ(first_error(with_line(15, "NODE (3, MIX, 3, 2, MIX2)")), "a.txt:15:7: node 3 is defined twice");
+    CHECK_EQ(first_error(with_line(15, "NODE (6, OUTPUT, output, OUT1)")), "a.txt: node 5 is not defined");
+    CHECK_EQ(first_error(with_line(15, "EDGE (4, 1)")), "a.txt: the edges form a cycle");
+    CHECK_EQ(first_error(with_line(11, "MOD (DIS1, 1)")), "a.txt:4:7: mixer MIX1 needs a size, MOD (MIX1, width, height)");
+}
+
+TEST(parser_reports_missing_file){
+    Architecture arch;
+    CHECK(!arch.build_from_file(testcase_dir() + "/no_such_file.txt"));
+    REQUIRE(arch.errors_.size() == 1);
+    CHECK_EQ(arch.errors_[0], testcase_dir() + "/no_such_file.txt: cannot open file");
+    CHECK(arch.nodes_.empty());
+}
@@ -0,0 +1,75 @@
+#include "test.h"
+#include "OnePassSynth.h"
+
+#include <thread>
+#include <chrono>
+
+using namespace std;
+
+// every phase only ever adds, however often the encoding is rebuilt for another grid
+static void check_counters(const SolverStats& stats){
+    for(int p = 0; p < NO_OF_PHASES; p++){
+        CHECK(stats.phases_[p].ms_ >= 0);
+        CHECK(stats.phases_[p].assertions_ >= 0);
+        CHECK(stats.phases_[p].vars_ >= 0);
+    }
+    for(auto& cs: stats.checks_){
+        CHECK(cs.build_ms_ >= 0);
+        CHECK(cs.check_ms_ >= 0);
+    }
+}
+
+TEST(stats_counters_are_not_negative){
+    OnePassSynth synth(testcase_dir() + "/5_multiple_dispense.txt");
+    CHECK(!synth.solve(3, 3, 4));
+    CHECK(synth.solve(4, 3, 8)); // another grid, a new encoding
+    CHECK(synth.solve(3, 3, 8));
+    const SolverStats& stats = synth.get_stats();
+    CHECK_EQ(stats.checks_.size(), 3u);
+    CHECK(stats.phases_[PHASE_INIT].vars_ > 0);
+    CHECK(stats.phases_[PHASE_EXTEND].vars_ > 0);
+    check_counters(stats);
+}
+
+TEST(stats_of_portfolio_workers_add_up){
+    OnePassSynth synth(testcase_dir() + "/5_multiple_dispense.txt");
+    synth.set_threads(3);
+    REQUIRE(synth.solve());
+    check_counters(synth.get_stats());
+    // the workers that lost were interrupted, nothing was passed over
+    CHECK_EQ(synth.get_stats().no_of_skipped(), 0);
+}
+
+// interrupted candidates are not skipped ones, a result is still proven as far as it goes
+static void check_interrupted(OnePassSynth& synth){
+    const SolverStats& stats = synth.get_stats();
+    CHECK_EQ(stats.no_of_skipped(), 0);
+    for(auto& cs: stats.checks_){
+        if(cs.result_ == "unknown"){
+            CHECK_EQ(cs.reason_, "interrupted");
+        }
+    }
+}
+
+TEST(stats_interrupts_are_not_skips){
+    // at a few points of building and checking, whichever the interrupt hits
+    for(int delay_ms: {0, 5, 50, 200}){
+        OnePassSynth synth(testcase_dir() + "/9_PCR.txt");
+        thread stopper([&](){
+            this_thread::sleep_for(chrono::milliseconds(delay_ms));
+            synth.interrupt();
+        });
+        CHECK(!synth.solve(4, 4, 30));
+        stopper.join();
+        check_interrupted(synth);
+    }
+    OnePassSynth portfolio(testcase_dir() + "/9_PCR.txt");
+    portfolio.set_threads(4);
+    thread stopper([&](){
+        this_thread::sleep_for(chrono::milliseconds(300));
+        portfolio.interrupt();
+    });
+    CHECK(!portfolio.solve());
+    stopper.join();
+    check_interrupted(portfolio);
+}
@@ -0,0 +1,167 @@
+#include "test.h"
+#include "SolutionTrace.h"
+#include "OnePassSynth.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static vector<unsigned char> read_file(const string& filename){
+    ifstream in(filename, ios::binary);
+    return vector<unsigned char>(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+// a 3 x 2 grid over 70 steps: a droplet walking around, a mixer now and then, so there are
+// several key frames and delta frames of every size in between
+struct SyntheticTrace {
+    int width_, height_, time_;
+    vector<int> cells_; // [t][y][x]
+    vector<Node> ports_;
+    vector<vector<pair<bool, string>>> detectors_; // [y][x]
+
+    SyntheticTrace(): width_(3), height_(2), time_(70) {
+        cells_.assign((time_ + 1) * height_ * width_, -3);
+        for(int t = 1; t <= time_; t++){
+            int* frame = &cells_[t * height_ * width_];
+            frame[t % (height_ * width_)] = t % 4;
+            if(t % 9 < 3){
+                frame[0] = -2;
+                frame[1] = -2;
+            }
+            if(t % 17 == 0){
+                frame[5] = -1;
+            }
+        }
+        ports_.assign((width_ + height_) * 2, Node{0, ""});
+        ports_[0] = Node{DISPENSER, "DIS1"};
+        ports_[4] = Node{SINK, "OUT1"};
+        detectors_.assign(height_, vector<pair<bool, string>>(width_, make_pair(false, string())));
+        detectors_[1][2] = make_pair(true, string("DET1"));
+    }
+
+    int cell(int t, int x, int y) const { return cells_[(t * height_ + y) * width_ + x]; }
+};
+
+static bool same_frame(const SyntheticTrace& st, int t, const vector<vector<int>>& grid){
+    if((int)grid.size() != st.height_){
+        return false;
+    }
+    for(int y = 0; y < st.height_; y++){
+        for(int x = 0; x < st.width_; x++){
+            if((int)grid[y].size() != st.width_ || grid[y][x] != st.cell(t, x, y)){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+TEST(trace_round_trip){
+    SyntheticTrace st;
+    string filename = scratch_path("synthetic.trace");
+    REQUIRE(write_trace(filename, st.width_, st.height_, st.time_, st.cells_, st.ports_, st.detectors_));
+    vector<unsigned char> data = read_file(filename);
+
+    TraceReader reader;
+    REQUIRE(reader.open(data.data(), data.size()));
+    CHECK_EQ(reader.get_width(), st.width_);
+    CHECK_EQ(reader.get_height(), st.height_);
+    REQUIRE(reader.get_frames() == st.time_ + 1);
+    REQUIRE(reader.get_sink_dispenser_pos().size() == st.ports_.size());
+    for(size_t p = 0; p < st.ports_.size(); p++){
+        CHECK_EQ(reader.get_sink_dispenser_pos()[p].type_, st.ports_[p].type_);
+        CHECK_EQ(reader.get_sink_dispenser_pos()[p].label_, st.ports_[p].label_);
+    }
+    CHECK(reader.get_detector_pos() == st.detectors_);
+
+    // forward one delta at a time, then backwards and jumping across key frames
+    vector<vector<int>> grid;
+    for(int t = 0; t <= st.time_; t++){
+        REQUIRE(reader.frame(t, grid));
+        CHECK(same_frame(st, t, grid));
+    }
+    for(int t = st.time_; t >= 0; t -= 7){
+        REQUIRE(reader.frame(t, grid));
+        CHECK(same_frame(st, t, grid));
+    }
+    int jumps[] = {5, 64, 33, 31, 32, 0, 70};
+    for(int t: jumps){
+        REQUIRE(reader.frame(t, grid));
+        CHECK(same_frame(st, t, grid));
+    }
+    CHECK(!reader.frame(st.time_ + 1, grid));
+    CHECK(!reader.frame(-1, grid));
+}
+
+TEST(trace_of_a_solution){
+    OnePassSynth synth(testcase_dir() + "/4_mix_detect.txt");
+    REQUIRE(synth.solve(3, 3, 9));
+    string filename = scratch_path("4_mix_detect.trace");
+    REQUIRE(synth.save_trace(filename));
+    vector<unsigned char> data = read_file(filename);
+
+    TraceReader reader;
+    REQUIRE(reader.open(data.data(), data.size()));
+    vector<vector<vector<int>>> expected = synth.get_grid();
+    REQUIRE(reader.get_frames() == (int)expected.size());
+    vector<vector<int>> grid;
+    for(int t = 0; t < reader.get_frames(); t++){
+        REQUIRE(reader.frame(t, grid));
+        CHECK(grid == expected[t]);
+    }
+    vector<Node> ports = synth.get_sink_dispenser_pos();
+    REQUIRE(reader.get_sink_dispenser_pos().size() == ports.size());
+    for(size_t p = 0; p < ports.size(); p++){
+        CHECK_EQ(reader.get_sink_dispenser_pos()[p].label_, ports[p].label_);
+    }
+    CHECK(reader.get_detector_pos() == synth.get_detector_pos());
+}
+
+TEST(trace_rejects_truncated_files){
+    SyntheticTrace st;
+    string filename = scratch_path("truncated.trace");
+    REQUIRE(write_trace(filename, st.width_, st.height_, st.time_, st.cells_, st.ports_, st.detectors_));
+    vector<unsigned char> data = read_file(filename);
+    // a copy of exactly the prefix, so reading past it is an error a sanitizer sees
+    for(size_t size = 0; size < data.size(); size++){
+        vector<unsigned char> prefix(data.begin(), data.begin() + size);
+        TraceReader reader;
+        CHECK(!reader.open(prefix.data(), prefix.size()));
+        CHECK(!reader.get_error().empty());
+    }
+}
+
+TEST(trace_survives_corrupt_files){
+    SyntheticTrace st;
+    string filename = scratch_path("corrupt.trace");
+    REQUIRE(write_trace(filename, st.width_, st.height_, st.time_, st.cells_, st.ports_, st.detectors_));
+    vector<unsigned char> data = read_file(filename);
+
+    vector<unsigned char> bad_magic = data;
+    bad_magic[0] = 'X';
+    TraceReader reader;
+    CHECK(!reader.open(bad_magic.data(), bad_magic.size()));
+    CHECK_EQ(reader.get_error(), "not a solution trace");
+
+    // any byte changed: the trace is rejected, or reads as some frames without going out of bounds
+    for(size_t k = 8; k < data.size(); k++){
+        vector<unsigned char> copy = data;
+        copy[k] ^= 0xff;
+        TraceReader corrupt;
+        if(!corrupt.open(copy.data(), copy.size())){
+            CHECK(!corrupt.get_error().empty());
+            continue;
+        }
+        vector<vector<int>> grid;
+        for(int t = 0; t < corrupt.get_frames(); t++){
+            if(!corrupt.frame(t, grid)){
+                CHECK(!corrupt.get_error().empty());
+                break;
+            }
+            CHECK_EQ((int)grid.size(), corrupt.get_height());
+        }
+    }
+}